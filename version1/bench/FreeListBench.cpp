@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "../include/MemoryPool.h"
+
+using namespace MyMemoryPool;
+
+// Throughput of newElement/deleteElement at 1 to 32 threads.
+// Built twice: FreeListBench uses the lock-free free lists with per-thread magazines,
+// FreeListBench_mutex the original mutex-protected free lists (MEMORYPOOL_MUTEX_FREELIST).
+//   pairs: allocate and immediately free objects of five sizes, as in test.cpp
+//   burst: allocate BURST objects of mixed sizes, then free them all, so slots move between the
+//          magazines and the shared free lists
+
+static const size_t OPS_PER_THREAD = 2000000;
+static const size_t BURST = 256;
+
+template <size_t N>
+struct Object { char data[N]; explicit Object(char c) { data[0] = c; } };
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void pairs() {
+    for (size_t k = 0; k < OPS_PER_THREAD / 5; ++k) {
+        deleteElement(newElement<Object<4>>('a'));
+        deleteElement(newElement<Object<20>>('b'));
+        deleteElement(newElement<Object<40>>('c'));
+        deleteElement(newElement<Object<80>>('d'));
+        deleteElement(newElement<Object<200>>('e'));
+    }
+}
+
+static void burst() {
+    std::vector<void*> ptrs(BURST);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (size_t round = 0; round < OPS_PER_THREAD / BURST; ++round) {
+        for (size_t i = 0; i < BURST; ++i) {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            size_t size = MIN_BYTES + state % (MAX_BYTES - MIN_BYTES);
+            ptrs[i] = BlockToHash::allocateMemory(size);
+            *reinterpret_cast<size_t*>(ptrs[i]) = size;
+        }
+        for (size_t i = 0; i < BURST; ++i) {
+            BlockToHash::freeMemory(ptrs[i], *reinterpret_cast<size_t*>(ptrs[i]));
+        }
+    }
+}
+
+static double run(size_t works, void (*workload)()) { // Returns Mops/s over all threads
+    std::vector<std::thread> threads;
+    uint64_t start = nowNs();
+    for (size_t i = 0; i < works; ++i) threads.emplace_back(workload);
+    for (auto& thread : threads) thread.join();
+    uint64_t ns = nowNs() - start;
+    return works * OPS_PER_THREAD * 1000.0 / ns;
+}
+
+int main() {
+    BlockToHash::initMemoryBlock();
+#ifdef MEMORYPOOL_MUTEX_FREELIST
+    printf("free list: mutex\n");
+#else
+    printf("free list: lock-free + per-thread magazines (%d slots)\n", MAGAZINE_SIZE);
+#endif
+    printf("%8s %16s %16s\n", "threads", "pairs(Mops/s)", "burst(Mops/s)");
+    size_t threadCounts[] = {1, 2, 4, 8, 16, 32};
+    for (size_t works : threadCounts) {
+        double p = run(works, pairs);
+        double b = run(works, burst);
+        printf("%8zu %16.2f %16.2f\n", works, p, b);
+    }
+    return 0;
+}
@@ -12,10 +12,15 @@ namespace MyMemoryPool
     #define MAX_BYTES 512
     #define MIN_BYTES 8
     #define BLOCKSIZE 4096
+    #define MAGAZINE_SIZE 32 // Max free slots a thread keeps per size class; refills and flushes move half of it
+
+    // Define MEMORYPOOL_MUTEX_FREELIST to build the original mutex-protected free list without per-thread
+    // magazines, e.g. to compare against it in bench/FreeListBench.
 
     struct MemorySlot
     {
-        MemorySlot* next;
+        // Atomic because a lock-free pop may read the link of a slot that another thread is popping at the same time
+        std::atomic<MemorySlot*> next;
     };
 
     class MemoryBlock
@@ -26,18 +31,52 @@ namespace MyMemoryPool
         void initialize(size_t);
         void* allocate();
         void deallocate(void*);
+#ifndef MEMORYPOOL_MUTEX_FREELIST
+        size_t allocateBatch(MemorySlot*& head, size_t count); // Null-terminated chain of up to count slots, returns its length
+        void deallocateBatch(MemorySlot* head, MemorySlot* tail); // Push a whole chain back with a single CAS
+#endif
     private:
         size_t alignPointer(char* ptr, size_t size);
         void allocateBlock();
+#ifndef MEMORYPOOL_MUTEX_FREELIST
+        size_t popFreeList(MemorySlot*& head, size_t count);
+        // The free list head packs the slot address into the low 48 bits and a counter that is bumped on every
+        // push and pop into the high 16 bits, so a CAS fails if the list changed in between even when the same
+        // slot is back on top (ABA). User-space addresses on x86-64 and AArch64 Linux fit in 48 bits.
+        static const int TAG_SHIFT = 48;
+        static const uint64_t POINTER_MASK = (1ULL << TAG_SHIFT) - 1;
+        static MemorySlot* untag(uint64_t top) { return reinterpret_cast<MemorySlot*>(top & POINTER_MASK); }
+        static uint64_t retag(MemorySlot* slot, uint64_t oldTop) {
+            return reinterpret_cast<uint64_t>(slot) | ((oldTop & ~POINTER_MASK) + (1ULL << TAG_SHIFT));
+        }
+#endif
     private:
         size_t _blockSize;
         size_t _slotSize;
         MemorySlot* _firstBlock;
         MemorySlot* _unusedSlot;
         MemorySlot* _endSlot;
+#ifdef MEMORYPOOL_MUTEX_FREELIST
         MemorySlot* _freeList;
         std::mutex _mutexFreeList;
-        std::mutex _mutexBlock;
+#else
+        std::atomic<uint64_t> _freeList; // Tagged pointer, see retag()
+#endif
+        std::mutex _mutexBlock; // Guards carving new slots from the current block
+    };
+
+    // Free slots a thread keeps in front of one MemoryBlock; allocation and deallocation touch only these
+    // while the magazine is neither empty nor full
+    struct Magazine
+    {
+        MemorySlot* head = nullptr;
+        size_t count = 0;
+    };
+
+    struct ThreadMagazines
+    {
+        Magazine magazines[FREE_LIST_SIZE];
+        ~ThreadMagazines(); // Hands the cached slots back to the shared free lists when the thread exits
     };
 
     class BlockToHash
@@ -53,7 +92,17 @@ namespace MyMemoryPool
             if(size > MAX_BYTES){
                 return operator new(size); // Use global new for large allocations
             }
-            return getMemoryBlock((size + MIN_BYTES - 1) / MIN_BYTES - 1).allocate(); //static_cast<double>(size) / MIN_BYTES
+            size_t index = (size + MIN_BYTES - 1) / MIN_BYTES - 1; //static_cast<double>(size) / MIN_BYTES
+#ifdef MEMORYPOOL_MUTEX_FREELIST
+            return getMemoryBlock(index).allocate();
+#else
+            Magazine& magazine = localMagazines().magazines[index];
+            MemorySlot* slot = magazine.head;
+            if(slot == nullptr) return refillMagazine(index);
+            magazine.head = slot->next.load(std::memory_order_relaxed);
+            magazine.count--;
+            return slot;
+#endif
         }
         static void freeMemory(void* ptr, size_t size){
             if(ptr == nullptr) return;
@@ -61,8 +110,26 @@ namespace MyMemoryPool
                 operator delete(ptr); // Use global delete for large allocations
                 return;
             }
-            getMemoryBlock((size + MIN_BYTES - 1) / MIN_BYTES - 1).deallocate(ptr);
+            size_t index = (size + MIN_BYTES - 1) / MIN_BYTES - 1;
+#ifdef MEMORYPOOL_MUTEX_FREELIST
+            getMemoryBlock(index).deallocate(ptr);
+#else
+            Magazine& magazine = localMagazines().magazines[index];
+            MemorySlot* slot = reinterpret_cast<MemorySlot*>(ptr);
+            slot->next.store(magazine.head, std::memory_order_relaxed);
+            magazine.head = slot;
+            if(++magazine.count > MAGAZINE_SIZE) flushMagazine(index);
+#endif
+        }
+#ifndef MEMORYPOOL_MUTEX_FREELIST
+    private:
+        static ThreadMagazines& localMagazines(){
+            static thread_local ThreadMagazines magazines;
+            return magazines;
         }
+        static void* refillMagazine(size_t index); // Magazine empty: take half a magazine from the MemoryBlock
+        static void flushMagazine(size_t index); // Magazine over capacity: give half of it back
+#endif
     };
 
     template <typename T, typename... Args>
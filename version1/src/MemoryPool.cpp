@@ -1,12 +1,12 @@
 #include "../include/MemoryPool.h"
 
-namespace MyMemoryPool 
+namespace MyMemoryPool
 {
 MemoryBlock::MemoryBlock(size_t blockSize) : _blockSize(blockSize) {}
 MemoryBlock::~MemoryBlock(){
     MemorySlot* cur = _firstBlock;
     while (cur){
-        MemorySlot* next = cur->next;
+        MemorySlot* next = cur->next.load(std::memory_order_relaxed);
         operator delete(cur);
         cur = next;
     }
@@ -17,22 +17,27 @@ void MemoryBlock::initialize(size_t slotSize) {
     _firstBlock = nullptr;
     _unusedSlot = nullptr;
     _endSlot = nullptr;
+#ifdef MEMORYPOOL_MUTEX_FREELIST
     _freeList = nullptr;
+#else
+    _freeList.store(0, std::memory_order_relaxed);
+#endif
 }
 
+#ifdef MEMORYPOOL_MUTEX_FREELIST
 void* MemoryBlock::allocate() {
     {
         std::lock_guard<std::mutex> lock(_mutexFreeList);
         if (_freeList != nullptr) {
             MemorySlot* slot = _freeList;
-            _freeList = _freeList->next;
+            _freeList = _freeList->next.load(std::memory_order_relaxed);
             return slot;
         }
     }
     MemorySlot* slot;
     {
         std::lock_guard<std::mutex> lock(_mutexBlock);
-        if (_unusedSlot >= _endSlot) {
+        if (reinterpret_cast<char*>(_unusedSlot) + _slotSize > reinterpret_cast<char*>(_endSlot)) {
             allocateBlock();
         }
         slot = _unusedSlot;
@@ -45,21 +50,94 @@ void MemoryBlock::deallocate(void* ptr) {
     if (ptr == nullptr) return;
     {
         std::lock_guard<std::mutex> lock(_mutexFreeList);
-        reinterpret_cast<MemorySlot*>(ptr)->next = _freeList;
+        reinterpret_cast<MemorySlot*>(ptr)->next.store(_freeList, std::memory_order_relaxed);
         _freeList = reinterpret_cast<MemorySlot*>(ptr);
     }
 }
+#else
+void* MemoryBlock::allocate() {
+    MemorySlot* slot = nullptr;
+    allocateBatch(slot, 1);
+    return slot;
+}
+
+void MemoryBlock::deallocate(void* ptr) {
+    if (ptr == nullptr) return;
+    MemorySlot* slot = reinterpret_cast<MemorySlot*>(ptr);
+    deallocateBatch(slot, slot);
+}
+
+size_t MemoryBlock::allocateBatch(MemorySlot*& head, size_t count) {
+    size_t got = popFreeList(head, count);
+    if (got == count) return got;
+    // Free list ran dry: carve the rest from the current block under one lock
+    std::lock_guard<std::mutex> lock(_mutexBlock);
+    for (; got < count; ++got) {
+        if (reinterpret_cast<char*>(_unusedSlot) + _slotSize > reinterpret_cast<char*>(_endSlot)) {
+            allocateBlock();
+        }
+        MemorySlot* slot = _unusedSlot;
+        _unusedSlot = reinterpret_cast<MemorySlot*>(reinterpret_cast<char*>(_unusedSlot) + _slotSize);
+        slot->next.store(head, std::memory_order_relaxed);
+        head = slot;
+    }
+    return got;
+}
+
+void MemoryBlock::deallocateBatch(MemorySlot* head, MemorySlot* tail) {
+    uint64_t top = _freeList.load(std::memory_order_relaxed);
+    do {
+        tail->next.store(untag(top), std::memory_order_relaxed);
+    } while (!_freeList.compare_exchange_weak(top, retag(head, top), std::memory_order_release, std::memory_order_relaxed));
+}
+
+size_t MemoryBlock::popFreeList(MemorySlot*& head, size_t count) {
+    uint64_t top = _freeList.load(std::memory_order_acquire);
+    for (;;) {
+        MemorySlot* first = untag(top);
+        if (first == nullptr) {
+            head = nullptr;
+            return 0;
+        }
+        // Walk up to count slots. A link is only followed after checking that the list is unchanged, i.e. the
+        // slot holding it was still on the list when it was read; otherwise it may be user data by now.
+        // Slots are never returned to the system while the pool lives, so reading a stale slot is harmless.
+        MemorySlot* last = first;
+        MemorySlot* rest = last->next.load(std::memory_order_relaxed);
+        size_t got = 1;
+        bool changed = false;
+        while (got < count && rest != nullptr) {
+            if (_freeList.load(std::memory_order_acquire) != top) {
+                changed = true;
+                break;
+            }
+            last = rest;
+            rest = last->next.load(std::memory_order_relaxed);
+            ++got;
+        }
+        if (changed) {
+            top = _freeList.load(std::memory_order_acquire);
+            continue;
+        }
+        if (_freeList.compare_exchange_weak(top, retag(rest, top), std::memory_order_acquire, std::memory_order_acquire)) {
+            last->next.store(nullptr, std::memory_order_relaxed);
+            head = first;
+            return got;
+        }
+    }
+}
+#endif
 
 void MemoryBlock::allocateBlock() {
     void* newBlock = operator new(_blockSize);
-    reinterpret_cast<MemorySlot*>(newBlock)->next = _firstBlock;
+    reinterpret_cast<MemorySlot*>(newBlock)->next.store(_firstBlock, std::memory_order_relaxed);
     _firstBlock = reinterpret_cast<MemorySlot*>(newBlock);
 
     char* ptr = reinterpret_cast<char*>(newBlock) + sizeof(MemorySlot*);
     size_t alignSize = alignPointer(ptr, _slotSize);
     _unusedSlot = reinterpret_cast<MemorySlot*>(ptr + alignSize);
     _endSlot = reinterpret_cast<MemorySlot*>(reinterpret_cast<char*>(newBlock) + _blockSize);
-    _freeList = nullptr;
+    // The free list is left alone: slots freed from earlier blocks stay usable
 }
 
 size_t MemoryBlock::alignPointer(char* ptr, size_t size) {
@@ -74,12 +152,47 @@ void BlockToHash::initMemoryBlock() {
 }
 
 MemoryBlock& BlockToHash::getMemoryBlock(size_t index) {
-    static std::vector<MemoryBlock> memoryBlocks(FREE_LIST_SIZE);
-    if (index >= memoryBlocks.size()) {
-        std::cerr << "Index out of bounds: " << index << std::endl;
-        throw std::out_of_range("Index out of bounds");
-    }
+    // A plain array: allocateMemory/freeMemory only pass indices below FREE_LIST_SIZE, so no range check on the hot path
+    static MemoryBlock memoryBlocks[FREE_LIST_SIZE];
+    assert(index < FREE_LIST_SIZE);
     return memoryBlocks[index];
 }
 
+#ifndef MEMORYPOOL_MUTEX_FREELIST
+void* BlockToHash::refillMagazine(size_t index) {
+    Magazine& magazine = localMagazines().magazines[index];
+    MemorySlot* head = nullptr;
+    size_t count = getMemoryBlock(index).allocateBatch(head, MAGAZINE_SIZE / 2);
+    magazine.head = head->next.load(std::memory_order_relaxed); // Keep all but the first slot, which is returned
+    magazine.count = count - 1;
+    return head;
+}
+
+void BlockToHash::flushMagazine(size_t index) {
+    Magazine& magazine = localMagazines().magazines[index];
+    MemorySlot* head = magazine.head;
+    MemorySlot* tail = head;
+    for (size_t i = 1; i < MAGAZINE_SIZE / 2; ++i) {
+        tail = tail->next.load(std::memory_order_relaxed);
+    }
+    magazine.head = tail->next.load(std::memory_order_relaxed);
+    magazine.count -= MAGAZINE_SIZE / 2;
+    getMemoryBlock(index).deallocateBatch(head, tail);
+}
+
+ThreadMagazines::~ThreadMagazines() {
+    for (size_t i = 0; i < FREE_LIST_SIZE; ++i) {
+        MemorySlot* head = magazines[i].head;
+        if (head == nullptr) continue;
+        MemorySlot* tail = head;
+        while (tail->next.load(std::memory_order_relaxed) != nullptr) {
+            tail = tail->next.load(std::memory_order_relaxed);
+        }
+        BlockToHash::getMemoryBlock(i).deallocateBatch(head, tail);
+        magazines[i].head = nullptr;
+        magazines[i].count = 0;
+    }
+}
+#endif
+
 } // namespace MyMemoryPool
@@ -0,0 +1,93 @@
+#include "../include/UseMemoryPool.h"
+#include "../include/MonotonicArena.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// 请求形态的负载：每个请求分配OBJECTS个16B~256B的对象并一直持有到请求结束，
+// 中间有SUBTASKS个子任务，各自分配TEMPS个临时对象，子任务结束时丢弃
+//   pool: localAllocate/localDeallocate逐个分配释放
+//   arena-reset: 子任务使用MonotonicArena::Scope，请求结束时reset()，保留一个Span给下一个请求
+//   arena-release: 同上，但请求结束时release()，每个请求都向PageCache取、还Span
+static const size_t REQUESTS = 2000; // 每个线程处理的请求数
+static const size_t OBJECTS = 2000;
+static const size_t SUBTASKS = 4;
+static const size_t TEMPS = 200;
+
+struct Request {
+    void* _objects[OBJECTS];
+    size_t _sizes[OBJECTS];
+    void* _temps[TEMPS];
+    size_t _tempSizes[TEMPS];
+};
+
+static size_t objectSize(uint64_t& state) {
+    return 16 + BenchUtil::nextRand(state) % 241;
+}
+
+static void touch(void* ptr, size_t size) { // 写头尾各一个字节，模拟初始化
+    static_cast<char*>(ptr)[0] = 1;
+    static_cast<char*>(ptr)[size - 1] = 1;
+}
+
+static void poolRequest(Request& req, uint64_t& state) {
+    for(size_t sub = 0; sub < SUBTASKS; ++sub){
+        for(size_t i = sub * OBJECTS / SUBTASKS; i < (sub + 1) * OBJECTS / SUBTASKS; ++i){
+            req._sizes[i] = objectSize(state);
+            req._objects[i] = localAllocate(req._sizes[i]);
+            touch(req._objects[i], req._sizes[i]);
+        }
+        for(size_t i = 0; i < TEMPS; ++i){
+            req._tempSizes[i] = objectSize(state);
+            req._temps[i] = localAllocate(req._tempSizes[i]);
+            touch(req._temps[i], req._tempSizes[i]);
+        }
+        for(size_t i = 0; i < TEMPS; ++i) localDeallocate(req._temps[i], req._tempSizes[i]);
+    }
+    for(size_t i = 0; i < OBJECTS; ++i) localDeallocate(req._objects[i], req._sizes[i]);
+}
+
+static void arenaRequest(MonotonicArena& arena, Request& req, uint64_t& state, bool release) {
+    for(size_t sub = 0; sub < SUBTASKS; ++sub){
+        for(size_t i = sub * OBJECTS / SUBTASKS; i < (sub + 1) * OBJECTS / SUBTASKS; ++i){
+            size_t size = objectSize(state);
+            req._objects[i] = arena.allocate(size);
+            touch(req._objects[i], size);
+        }
+        MonotonicArena::Scope scope(arena); // 子任务的临时对象在作用域结束时整体回退
+        for(size_t i = 0; i < TEMPS; ++i){
+            size_t size = objectSize(state);
+            req._temps[i] = arena.allocate(size);
+            touch(req._temps[i], size);
+        }
+    }
+    if(release) arena.release();
+    else arena.reset();
+}
+
+template<typename Body>
+static void run(const char* name, size_t works, Body body) {
+    uint64_t ns = BenchUtil::runThreads(works, [&](size_t id){
+        Request* req = new Request; // 请求的指针数组本身不计入比较
+        MonotonicArena arena;
+        uint64_t state = 0x9e3779b97f4a7c15ULL + id;
+        for(size_t r = 0; r < REQUESTS; ++r) body(arena, *req, state);
+        delete req;
+    });
+    double requests = (double)works * REQUESTS;
+    double allocs = requests * (OBJECTS + SUBTASKS * TEMPS);
+    printf("%-14s %8zu %12.2f us/request %10.2f ns/alloc\n", name, works, ns / requests / 1000, ns / allocs);
+}
+
+int main() {
+    printf("每个请求分配%zu个16B~256B的对象，%zu个子任务各分配%zu个临时对象\n", OBJECTS, SUBTASKS, TEMPS);
+    printf("%-14s %8s %23s %19s\n", "mode", "threads", "request", "alloc");
+    size_t threadCounts[] = {1, 4};
+    for(size_t works : threadCounts){
+        run("pool", works, [](MonotonicArena&, Request& req, uint64_t& state){ poolRequest(req, state); });
+        run("arena-reset", works, [](MonotonicArena& arena, Request& req, uint64_t& state){ arenaRequest(arena, req, state, false); });
+        run("arena-release", works, [](MonotonicArena& arena, Request& req, uint64_t& state){ arenaRequest(arena, req, state, true); });
+    }
+    return 0;
+}
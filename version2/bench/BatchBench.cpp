@@ -0,0 +1,48 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 一次需要大量同样大小的对象（构建图的节点、解析出的报文）：每轮分配BATCH个对象，写入后整批释放
+//   single: 逐个调用localAllocate/localDeallocate
+//   batch: localAllocateBatch/localDeallocateBatch
+// 每个大小分别在1个和4个线程下运行，输出每个对象分配加释放的耗时
+static const size_t BATCH = 4096;
+static const size_t ROUNDS = 500;
+
+template<typename Body>
+static void run(const char* name, size_t size, size_t works, Body body) {
+    uint64_t ns = BenchUtil::runThreads(works, [&](size_t){
+        std::vector<void*> ptrs(BATCH);
+        for(size_t round = 0; round < ROUNDS; ++round) body(ptrs.data());
+    });
+    printf("%-8s %8zu %8zu %10.2f ns/object\n", name, size, works, (double)ns / (works * ROUNDS * BATCH));
+}
+
+static void touch(void** ptrs) {
+    for(size_t i = 0; i < BATCH; ++i) *static_cast<size_t*>(ptrs[i]) = i;
+}
+
+int main() {
+    printf("每轮%zu个对象，共%zu轮\n", BATCH, ROUNDS);
+    printf("%-8s %8s %8s %20s\n", "mode", "size", "threads", "alloc+free");
+    size_t sizes[] = {16, 64, 256, 1024};
+    size_t threadCounts[] = {1, 4};
+    for(size_t size : sizes){
+        for(size_t works : threadCounts){
+            run("single", size, works, [size](void** ptrs){
+                for(size_t i = 0; i < BATCH; ++i) ptrs[i] = localAllocate(size);
+                touch(ptrs);
+                for(size_t i = 0; i < BATCH; ++i) localDeallocate(ptrs[i], size);
+            });
+            run("batch", size, works, [size](void** ptrs){
+                if(localAllocateBatch(size, BATCH, ptrs) != BATCH) abort();
+                touch(ptrs);
+                localDeallocateBatch(size, BATCH, ptrs);
+            });
+        }
+    }
+    return 0;
+}
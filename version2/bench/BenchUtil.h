@@ -0,0 +1,45 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+namespace BenchUtil {
+
+    static inline uint64_t nowNs() { // 墙上时间（单调时钟），单位纳秒
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static inline uint64_t runThreads(size_t works, const std::function<void(size_t)>& fn) { // 并发执行fn，返回总耗时(ns)
+        std::vector<std::thread> threads(works);
+        uint64_t start = nowNs();
+        for(size_t i = 0; i < works; ++i){
+            threads[i] = std::thread(fn, i);
+        }
+        for(auto& t : threads){
+            t.join();
+        }
+        return nowNs() - start;
+    }
+
+    static inline size_t currentRSS() { // 当前进程常驻内存大小(字节)，读取/proc/self/statm
+        FILE* fp = fopen("/proc/self/statm", "r");
+        if(fp == nullptr) return 0;
+        size_t pages = 0, resident = 0;
+        if(fscanf(fp, "%zu %zu", &pages, &resident) != 2) resident = 0;
+        fclose(fp);
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+    static inline uint64_t nextRand(uint64_t& state) { // xorshift64，避免rand()的全局锁影响测量
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+} // namespace BenchUtil
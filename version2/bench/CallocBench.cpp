@@ -0,0 +1,92 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 新内存不再memset、CentralCache按批次懒切分Span之后：
+// 启动: 进程中第一次分配的耗时与RSS增长，包括各单例的构造和第一个Span的申请
+// 预热: 每个size class各分配一个对象并写入开头的一个缓存行后释放，之后的RSS
+// calloc: 不同大小下glibc calloc、先分配再memset以及localCallocate的耗时，每个对象只检查首尾字节
+//   新内存: 连续分配共FRESH_BYTES字节后再全部释放，内存都是第一次使用
+//   复用: 只同时持有LIVE个对象反复替换，内存块大多是刚释放、写脏过的
+static const size_t FRESH_BYTES = 64 * 1024 * 1024;
+static const size_t CALLOC_ROUNDS = 2000;
+static const size_t LIVE = 4; // 复用时同时持有的对象数
+
+static void startup() {
+    size_t rssBefore = BenchUtil::currentRSS();
+    uint64_t start = BenchUtil::nowNs();
+    void* ptr = localAllocate(16);
+    uint64_t ns = BenchUtil::nowNs() - start;
+    size_t rssAfter = BenchUtil::currentRSS();
+    printf("启动: 第一次分配 %8.1f us   RSS增长 %8zu KB\n", ns / 1000.0, (rssAfter - rssBefore) / 1024);
+    localDeallocate(ptr, 16);
+}
+
+static void warmup() {
+    size_t rssBefore = BenchUtil::currentRSS();
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t index = 0; index < FREE_LIST_SIZE; ++index){
+        size_t size = SizeClass::classSize(index);
+        void* ptr = localAllocate(size);
+        memset(ptr, 1, size < 64 ? size : 64);
+        localDeallocate(ptr, size);
+    }
+    uint64_t ns = BenchUtil::nowNs() - start;
+    size_t rssAfter = BenchUtil::currentRSS();
+    printf("预热: %zu个size class %8.1f us   RSS增长 %8zu KB\n", (size_t)FREE_LIST_SIZE, ns / 1000.0, (rssAfter - rssBefore) / 1024);
+}
+
+template<typename Alloc, typename Free>
+static void bench(const char* name, size_t size, Alloc allocFn, Free freeFn) {
+    releaseFreeMemory(); // 上一轮的空闲页全部归还给操作系统，PageCache中的Span重新确定为零
+    size_t count = FRESH_BYTES / size;
+    std::vector<char*> ptrs(count);
+    size_t rssBefore = BenchUtil::currentRSS();
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t k = 0; k < count; ++k){
+        ptrs[k] = static_cast<char*>(allocFn(size));
+        if(ptrs[k][0] != 0 || ptrs[k][size - 1] != 0) abort(); // 内容必须为零
+    }
+    uint64_t freshNs = BenchUtil::nowNs() - start;
+    size_t freshRss = BenchUtil::currentRSS() - rssBefore;
+    for(size_t k = 0; k < count; ++k){
+        ptrs[k][0] = 1; // 写脏首字节，之后再分配到时必须重新清零
+        freeFn(ptrs[k], size);
+    }
+
+    char* live[LIVE] = {nullptr};
+    start = BenchUtil::nowNs();
+    for(size_t k = 0; k < CALLOC_ROUNDS; ++k){
+        size_t slot = k % LIVE;
+        if(live[slot] != nullptr) freeFn(live[slot], size);
+        live[slot] = static_cast<char*>(allocFn(size));
+        if(live[slot][0] != 0 || live[slot][size - 1] != 0) abort();
+        live[slot][0] = 1;
+    }
+    uint64_t reuseNs = BenchUtil::nowNs() - start;
+    for(size_t slot = 0; slot < LIVE; ++slot) freeFn(live[slot], size);
+    printf("%10zu B %-14s 新内存 %10.1f ns/op RSS增长 %8zu KB   复用 %10.1f ns/op\n", size, name,
+        (double)freshNs / count, freshRss / 1024, (double)reuseNs / CALLOC_ROUNDS);
+}
+
+int main() {
+    startup();
+    warmup();
+    size_t sizes[] = {64, 4 * 1024, 256 * 1024, 1024 * 1024, 8 * 1024 * 1024};
+    for(size_t size : sizes){
+        bench("glibc", size, [](size_t size){ return calloc(1, size); }, [](void* ptr, size_t){ free(ptr); });
+        bench("malloc+memset", size, [](size_t size){
+            void* ptr = localAllocate(size);
+            memset(ptr, 0, size);
+            return ptr;
+        }, [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+        bench("localCalloc", size, [](size_t size){ return localCallocate(1, size); },
+            [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+    }
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "../include/PoolAllocator.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 标准容器分别使用std::allocator、PoolAllocator以及（C++17下）以内存池为资源的std::pmr容器
+//   map: 随机键的滚动窗口，删除最早插入的键后插入新键，节点分配与释放交错
+//   list: 队头删除、队尾插入的滚动窗口
+//   unordered_map: 插入后全部删除，包含桶数组的多次扩容
+//   vector: 大量长度不一的小数组反复创建销毁
+// 以MEMORYPOOL_CXX17=ON配置时同时运行pmr版本
+static const size_t ELEMENTS = 200000;
+static const size_t ROUNDS = 10;
+
+template<template<typename> class Alloc>
+struct Containers {
+    typedef std::map<uint64_t, uint64_t, std::less<uint64_t>, Alloc<std::pair<const uint64_t, uint64_t>>> Map;
+    typedef std::list<uint64_t, Alloc<uint64_t>> List;
+    typedef std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>,
+        Alloc<std::pair<const uint64_t, uint64_t>>> HashMap;
+    typedef std::vector<uint32_t, Alloc<uint32_t>> Vector;
+};
+
+template<typename Map>
+static void mapChurn(Map& m) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    std::vector<uint64_t> keys(ELEMENTS); // 滚动窗口：删除ELEMENTS次插入之前的键，再插入一个新键
+    for(size_t i = 0; i < ELEMENTS; ++i) m.emplace(keys[i] = BenchUtil::nextRand(state), i);
+    for(size_t i = 0; i < ELEMENTS * ROUNDS / 4; ++i){
+        uint64_t& key = keys[i % ELEMENTS];
+        m.erase(key);
+        m.emplace(key = BenchUtil::nextRand(state), i);
+    }
+    m.clear();
+}
+
+template<typename List>
+static void listChurn(List& l) {
+    for(size_t i = 0; i < ELEMENTS; ++i) l.push_back(i);
+    for(size_t i = 0; i < ELEMENTS * ROUNDS; ++i){
+        l.pop_front();
+        l.push_back(i);
+    }
+    l.clear();
+}
+
+template<typename HashMap>
+static void hashChurn(HashMap& m) {
+    for(size_t round = 0; round < ROUNDS; ++round){
+        uint64_t state = 0x9e3779b97f4a7c15ULL + round;
+        for(size_t i = 0; i < ELEMENTS; ++i) m.emplace(BenchUtil::nextRand(state), i);
+        m.clear();
+        m.rehash(0); // 释放桶数组，下一轮重新扩容
+    }
+}
+
+template<typename Vector, typename Make>
+static void vectorChurn(Make make) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    std::vector<Vector> live; // 外层数组只分配一次，不计入比较
+    live.reserve(256);
+    for(size_t i = 0; i < ELEMENTS * ROUNDS / 8; ++i){
+        Vector v = make();
+        size_t n = 1 + BenchUtil::nextRand(state) % 32;
+        for(size_t k = 0; k < n; ++k) v.push_back((uint32_t)k); // 逐个push_back，包含多次扩容
+        if(live.size() < 256) live.push_back(std::move(v));
+        else live[BenchUtil::nextRand(state) % 256] = std::move(v);
+    }
+}
+
+template<typename Body>
+static void run(const char* name, const char* alloc, Body body) {
+    uint64_t start = BenchUtil::nowNs();
+    body();
+    uint64_t ns = BenchUtil::nowNs() - start;
+    printf("%-14s %-14s %10.2f ms\n", name, alloc, ns / 1e6);
+}
+
+template<template<typename> class Alloc>
+static void runAll(const char* alloc) {
+    typedef Containers<Alloc> C;
+    run("map", alloc, []{ typename C::Map m; mapChurn(m); });
+    run("list", alloc, []{ typename C::List l; listChurn(l); });
+    run("unordered_map", alloc, []{ typename C::HashMap m; hashChurn(m); });
+    run("vector", alloc, []{ vectorChurn<typename C::Vector>([]{ return typename C::Vector(); }); });
+}
+
+int main() {
+    printf("%zu个元素，%zu轮\n", ELEMENTS, ROUNDS);
+    printf("%-14s %-14s %13s\n", "container", "allocator", "time");
+    runAll<std::allocator>("std::allocator");
+    runAll<PoolAllocator>("PoolAllocator");
+#ifdef MEMORYPOOL_HAS_PMR
+    std::pmr::memory_resource* resource = &poolResource();
+    run("map", "pmr", [&]{ std::pmr::map<uint64_t, uint64_t> m(resource); mapChurn(m); });
+    run("list", "pmr", [&]{ std::pmr::list<uint64_t> l(resource); listChurn(l); });
+    run("unordered_map", "pmr", [&]{ std::pmr::unordered_map<uint64_t, uint64_t> m(resource); hashChurn(m); });
+    run("vector", "pmr", [&]{ vectorChurn<std::pmr::vector<uint32_t>>([&]{ return std::pmr::vector<uint32_t>(resource); }); });
+#endif
+    return 0;
+}
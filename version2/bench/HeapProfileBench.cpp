@@ -0,0 +1,103 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// 堆采样在快速路径上的开销：与StatsBench相同的8B~1KB混合分配释放，分别在关闭采样和不同采样间隔下运行
+// 关闭时每次分配只多一次倒计数的减法和分支，释放时只多一次读取存活采样数；开启后的额外开销来自采样时的backtrace和加锁
+// 最后保留四个调用点分配的对象，输出堆profile，检查估计值与实际存活字节数是否一致；
+// 其中calloc的大对象直接向PageCache申请、CpuCache不经过ThreadCache，同样应被采样，否则返回非0
+static const size_t ROUNDS = 100;
+static const size_t ITERATIONS = 10000;
+
+static size_t sizeOf(size_t k) {
+    return (k * 37) % 1024 + 1;
+}
+
+static double bench(size_t works) {
+    uint64_t ns = BenchUtil::runThreads(works, [](size_t){
+        std::vector<void*> ptrVec(ITERATIONS);
+        for(size_t j = 0; j < ROUNDS; ++j){
+            for(size_t k = 0; k < ITERATIONS; ++k){
+                ptrVec[k] = localAllocate(sizeOf(k));
+            }
+            for(size_t k = 0; k < ITERATIONS; ++k){
+                localDeallocate(ptrVec[k], sizeOf(k));
+            }
+        }
+    });
+    return (double)ns / (works * ROUNDS * ITERATIONS);
+}
+
+static double best(size_t works) { // 取三次中的最好成绩
+    double cost = bench(works);
+    for(int i = 0; i < 2; i++) cost = std::min(cost, bench(works));
+    return cost;
+}
+
+// 两个不同的调用点，profile中应分别出现；分配后写入一个字节，避免尾调用使这一层从调用栈中消失
+__attribute__((noinline)) static void* allocateNodes(size_t size) {
+    void* ptr = localAllocate(size);
+    *static_cast<char*>(ptr) = 0;
+    return ptr;
+}
+
+__attribute__((noinline)) static void* allocateBuffers(size_t size) {
+    void* ptr = localAllocate(size);
+    *static_cast<char*>(ptr) = 0;
+    return ptr;
+}
+
+__attribute__((noinline)) static void* allocateZeroed(size_t size) { // calloc的大对象路径
+    void* ptr = localCallocate(1, size);
+    *static_cast<char*>(ptr) = 0;
+    return ptr;
+}
+
+__attribute__((noinline)) static void* allocatePerCpu(size_t size) {
+    void* ptr = localCpuAllocate(size);
+    *static_cast<char*>(ptr) = 0;
+    return ptr;
+}
+
+int main() {
+    bench(1); // 预热
+    printf("%-12s %-8s %14s\n", "interval", "threads", "ns/op");
+    size_t intervals[] = {0, 512 * 1024, 64 * 1024};
+    for(size_t interval : intervals){
+        setHeapProfileInterval(interval);
+        for(size_t works = 1; works <= 4; works *= 2){
+            double cost = best(works);
+            printf("%-12zu %-8zu %14.2f\n", interval, works, cost);
+        }
+    }
+
+    setHeapProfileInterval(512 * 1024);
+    std::vector<void*> nodes, buffers, zeroed, perCpu;
+    for(size_t k = 0; k < 200000; ++k) nodes.push_back(allocateNodes(64)); // 约12.2MB
+    for(size_t k = 0; k < 1000; ++k) buffers.push_back(allocateBuffers(32 * 1024)); // 约31.3MB
+    size_t before = HeapProfiler::liveSamples();
+    for(size_t k = 0; k < 64; ++k) zeroed.push_back(allocateZeroed(1024 * 1024)); // 64MB，每个对象被采样的概率约86%
+    size_t zeroedSamples = HeapProfiler::liveSamples() - before;
+    before = HeapProfiler::liveSamples();
+    for(size_t k = 0; k < 100000; ++k) perCpu.push_back(allocatePerCpu(64)); // 约6.1MB，平均约12个采样
+    size_t perCpuSamples = HeapProfiler::liveSamples() - before;
+    printf("实际存活: nodes %zu KB, buffers %zu KB, zeroed %zu KB, perCpu %zu KB\n",
+        nodes.size() * 64 / 1024, buffers.size() * 32, zeroed.size() * 1024, perCpu.size() * 64 / 1024);
+    dumpHeapProfile(std::cout);
+    for(size_t k = 0; k < nodes.size(); ++k) localDeallocate(nodes[k], 64);
+    for(size_t k = 0; k < buffers.size(); ++k) localDeallocate(buffers[k], 32 * 1024);
+    for(size_t k = 0; k < zeroed.size(); ++k) localDeallocate(zeroed[k], 1024 * 1024);
+    for(size_t k = 0; k < perCpu.size(); ++k) localCpuDeallocate(perCpu[k], 64);
+    printf("全部释放后的存活采样: %zu\n", HeapProfiler::liveSamples());
+    if(zeroedSamples == 0 || perCpuSamples == 0) {
+        printf("FAILED: calloc的大对象采样%zu个，CpuCache采样%zu个\n", zeroedSamples, perCpuSamples);
+        return 1;
+    }
+    if(HeapProfiler::liveSamples() != 0) {
+        printf("FAILED: 全部释放后仍有存活采样\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace MyMemoryPool;
+
+// 1~16MB大缓冲区的反复申请释放：内存池的PageCache大对象路径 vs glibc malloc
+static const size_t WORKS = 4;
+static const size_t ITERATIONS = 2000; // 每个线程的替换次数
+static const size_t LIVE = 4; // 每个线程同时持有的缓冲区个数
+static const size_t MIN_SIZE = 1024 * 1024;
+static const size_t MAX_SIZE = 16 * 1024 * 1024;
+
+template<typename Alloc, typename Free>
+static void bench(const char* name, Alloc allocFn, Free freeFn) {
+    size_t rssBefore = BenchUtil::currentRSS();
+    uint64_t ns = BenchUtil::runThreads(WORKS, [&](size_t id){
+        uint64_t state = 0x2545f4914f6cdd1dULL + id;
+        char* live[LIVE] = {nullptr};
+        size_t sizes[LIVE] = {0};
+        for(size_t k = 0; k < ITERATIONS; ++k){
+            size_t slot = BenchUtil::nextRand(state) % LIVE;
+            if(live[slot] != nullptr) freeFn(live[slot], sizes[slot]);
+            sizes[slot] = MIN_SIZE + BenchUtil::nextRand(state) % (MAX_SIZE - MIN_SIZE);
+            live[slot] = static_cast<char*>(allocFn(sizes[slot]));
+            live[slot][0] = 1; // 只触碰首尾，测量的是分配器本身而不是缺页
+            live[slot][sizes[slot] - 1] = 1;
+        }
+        for(size_t slot = 0; slot < LIVE; ++slot){
+            if(live[slot] != nullptr) freeFn(live[slot], sizes[slot]);
+        }
+    });
+    size_t rssAfter = BenchUtil::currentRSS();
+    printf("%-10s %12.1f ns/op %12.2f Mops/s   RSS增长 %8zu KB\n", name,
+        (double)ns / ITERATIONS, WORKS * ITERATIONS * 1000.0 / ns,
+        rssAfter > rssBefore ? (rssAfter - rssBefore) / 1024 : 0);
+}
+
+int main() {
+    printf("%zu个线程，每线程%zu次替换，同时持有%zu个%zuMB~%zuMB的缓冲区\n",
+        WORKS, ITERATIONS, LIVE, MIN_SIZE >> 20, MAX_SIZE >> 20);
+    bench("glibc", [](size_t size){ return malloc(size); }, [](void* ptr, size_t){ free(ptr); });
+    bench("pool", [](size_t size){ return localAllocate(size); }, [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+    // 第二轮PageCache中已有足够的空闲Span，反映稳定状态下的开销
+    bench("pool-warm", [](size_t size){ return localAllocate(size); }, [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+    return 0;
+}
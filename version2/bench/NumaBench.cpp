@@ -0,0 +1,51 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 按NUMA节点划分PageCache和CentralCache：每个线程用setThreadNumaNode固定到一个节点
+// 本节点: 线程只释放自己分配的对象；跨节点: 线程把对象交给下一个节点的线程释放，内存块要回到所属节点的CentralCache
+// 单节点的机器可以设置环境变量MEMORYPOOL_NUMA_NODES=n模拟n个节点（不绑定物理内存，只验证划分和开销）
+static const size_t WORKS = 4;
+static const size_t OBJECTS = 200000; // 每个线程每轮分配的对象数
+static const size_t ROUNDS = 5;
+
+static size_t objectSize(uint64_t& state) { // 90%小对象，10%中等对象，保证会经常向CentralCache和PageCache申请
+    uint64_t r = BenchUtil::nextRand(state);
+    return r % 10 == 0 ? 4096 + (r >> 8) % (60 * 1024) : 8 + (r >> 8) % 1016;
+}
+
+static void run(const char* name, size_t shift) {
+    std::vector<std::vector<void*>> ptrs(WORKS, std::vector<void*>(OBJECTS));
+    uint64_t allocNs = 0, freeNs = 0;
+    for(size_t round = 0; round < ROUNDS; ++round){
+        allocNs += BenchUtil::runThreads(WORKS, [&](size_t id){
+            setThreadNumaNode((int)id);
+            uint64_t state = 0x9e3779b97f4a7c15ULL + id * 131 + round;
+            for(size_t k = 0; k < OBJECTS; ++k) ptrs[id][k] = localAllocate(objectSize(state));
+        });
+        freeNs += BenchUtil::runThreads(WORKS, [&](size_t id){
+            setThreadNumaNode((int)id);
+            for(void* ptr : ptrs[(id + shift) % WORKS]) localDeallocate(ptr); // shift为0时释放自己分配的对象
+        });
+    }
+    double ops = (double)WORKS * OBJECTS * ROUNDS;
+    PoolStats stats;
+    getPoolStats(stats);
+    uint64_t borrowed = 0; // 本节点mmap失败时从其他节点借用的Span数，正常情况下为0
+    for(size_t node = 0; node < stats._numaNodes; ++node) borrowed += stats._nodes[node]._borrowedSpans;
+    printf("%-8s 分配 %8.1f ns/op   释放 %8.1f ns/op   借用Span %llu\n", name, allocNs / ops, freeNs / ops, (unsigned long long)borrowed);
+}
+
+int main() {
+    PoolStats stats;
+    getPoolStats(stats);
+    printf("%zu个NUMA节点，%zu个线程依次固定到各节点，每轮每个线程分配%zu个8B~64KB的对象，共%zu轮\n",
+        stats._numaNodes, WORKS, OBJECTS, ROUNDS);
+    run("本节点", 0);
+    run("跨节点", 1);
+    dumpPoolStats(std::cout);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <mutex>
+
+using namespace MyMemoryPool;
+
+// 定长对象池：带构造参数的小对象在不同线程数下反复创建销毁，对比
+//   new/delete: 系统的operator new
+//   mutex-pool: 每次New/Delete加锁的空闲链表，即DtLenMemoryPool改为无锁栈之前的做法
+//   DtLen: DtLenMemoryPool::New/Delete，每次一个CAS
+//   DtLen-batch: NewN/DeleteN，每BATCH个对象一个CAS
+// 每个线程同时持有BATCH个对象，轮流整批创建、整批销毁
+static const size_t OPS = 4000000; // 每个线程创建的对象数
+static const size_t BATCH = 32;
+
+struct Order { // 典型的热点小对象，构造需要参数
+    uint64_t _id;
+    double _price;
+    int _quantity;
+    Order(uint64_t id, double price, int quantity) : _id(id), _price(price), _quantity(quantity) {}
+};
+
+class MutexPool { // 改动前DtLenMemoryPool的实现方式：一把锁保护空闲链表和切分
+public:
+    template<typename... Args>
+    Order* New(Args&&... args) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        void* ptr = _freeList;
+        if(ptr != nullptr) {
+            _freeList = ptrNext(ptr);
+        }else {
+            if(_remainSize < sizeof(Order)) {
+                _remainSize = 512 * 1024;
+                _memory = static_cast<char*>(systemAlloc(_remainSize >> PAGE_SHIFT));
+            }
+            ptr = _memory;
+            _memory += sizeof(Order);
+            _remainSize -= sizeof(Order);
+        }
+        return new(ptr) Order(std::forward<Args>(args)...);
+    }
+    void Delete(Order* ptr) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ptr->~Order();
+        ptrNext(ptr) = _freeList;
+        _freeList = ptr;
+    }
+private:
+    std::mutex _mutex;
+    void* _freeList = nullptr;
+    char* _memory = nullptr;
+    size_t _remainSize = 0;
+};
+
+static MutexPool mutexPool;
+static DtLenMemoryPool<Order> orderPool;
+
+template<typename Body>
+static void run(const char* name, size_t works, Body body) {
+    uint64_t ns = BenchUtil::runThreads(works, [&](size_t id){
+        Order* orders[BATCH];
+        for(size_t round = 0; round < OPS / BATCH; ++round) body(orders, id * OPS + round * BATCH);
+    });
+    printf("%-12s %8zu %10.2f ns/op\n", name, works, (double)ns / (works * OPS));
+}
+
+int main() {
+    printf("%-12s %8s %13s\n", "pool", "threads", "new+delete");
+    size_t threadCounts[] = {1, 2, 4, 8};
+    for(size_t works : threadCounts){
+        run("new/delete", works, [](Order** orders, uint64_t base){
+            for(size_t i = 0; i < BATCH; ++i) orders[i] = new Order(base + i, 1.5, 10);
+            for(size_t i = 0; i < BATCH; ++i) delete orders[i];
+        });
+        run("mutex-pool", works, [](Order** orders, uint64_t base){
+            for(size_t i = 0; i < BATCH; ++i) orders[i] = mutexPool.New(base + i, 1.5, 10);
+            for(size_t i = 0; i < BATCH; ++i) mutexPool.Delete(orders[i]);
+        });
+        run("DtLen", works, [](Order** orders, uint64_t base){
+            for(size_t i = 0; i < BATCH; ++i) orders[i] = orderPool.New(base + i, 1.5, 10);
+            for(size_t i = 0; i < BATCH; ++i) orderPool.Delete(orders[i]);
+        });
+        run("DtLen-batch", works, [](Order** orders, uint64_t base){
+            if(orderPool.NewN(orders, BATCH, base, 1.5, 10) != BATCH) abort();
+            orderPool.DeleteN(orders, BATCH);
+        });
+    }
+    return 0;
+}
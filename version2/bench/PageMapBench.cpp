@@ -0,0 +1,65 @@
+#include "../include/PageMap.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+
+using namespace MyMemoryPool;
+
+// 对比基数树页表与原先 std::unordered_map + 全局互斥锁 的查询吞吐量
+static const size_t NUM_PAGES = 64 * 1024; // 登记的页数（256MB地址空间）
+static const size_t LOOKUPS = 1000000; // 每个线程的查询次数
+static const PAGE_ID BASE_PAGE = 0x7f0000000ULL; // 模拟mmap返回的高地址页号
+
+static SpanPageMap pageMap; // 静态存储期，根节点零初始化
+static std::unordered_map<PAGE_ID, SpanList::Span*> hashMap;
+static std::mutex hashMutex;
+static std::vector<SpanList::Span> spans(NUM_PAGES / 8);
+
+static void setup() {
+    pageMap.ensure(BASE_PAGE, NUM_PAGES);
+    for(size_t i = 0; i < NUM_PAGES; ++i){
+        SpanList::Span* span = &spans[i / 8]; // 每8页属于同一个Span
+        pageMap.set(BASE_PAGE + i, span);
+        hashMap[BASE_PAGE + i] = span;
+    }
+}
+
+static double benchPageMap(size_t works) {
+    uint64_t ns = BenchUtil::runThreads(works, [](size_t id){
+        uint64_t state = 0x9e3779b97f4a7c15ULL + id;
+        size_t hit = 0;
+        for(size_t k = 0; k < LOOKUPS; ++k){
+            PAGE_ID page = BASE_PAGE + BenchUtil::nextRand(state) % NUM_PAGES;
+            hit += pageMap.get(page) != nullptr;
+        }
+        if(hit != LOOKUPS) printf("PageMap查询结果错误\n");
+    });
+    return works * LOOKUPS * 1000.0 / ns; // 百万次/秒
+}
+
+static double benchHashMap(size_t works) {
+    uint64_t ns = BenchUtil::runThreads(works, [](size_t id){
+        uint64_t state = 0x9e3779b97f4a7c15ULL + id;
+        size_t hit = 0;
+        for(size_t k = 0; k < LOOKUPS; ++k){
+            PAGE_ID page = BASE_PAGE + BenchUtil::nextRand(state) % NUM_PAGES;
+            std::unique_lock<std::mutex> lock(hashMutex); // 与原getIdOfSpan一致，每次查询都加全局锁
+            auto it = hashMap.find(page);
+            hit += it != hashMap.end();
+        }
+        if(hit != LOOKUPS) printf("unordered_map查询结果错误\n");
+    });
+    return works * LOOKUPS * 1000.0 / ns;
+}
+
+int main() {
+    setup();
+    printf("%-8s %20s %20s\n", "threads", "radix(Mops/s)", "hash+mutex(Mops/s)");
+    for(size_t works = 1; works <= 64; works *= 2){
+        double radix = benchPageMap(works);
+        double hash = benchHashMap(works);
+        printf("%-8zu %20.2f %20.2f\n", works, radix, hash);
+    }
+    return 0;
+}
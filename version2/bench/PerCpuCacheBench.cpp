@@ -0,0 +1,68 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <cstdio>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace MyMemoryPool;
+
+// 256个线程：每线程缓存(ThreadCache) vs 每CPU缓存(CpuCache) 的吞吐量与内存占用
+// 每种模式在独立的子进程中运行，避免RSS相互影响
+static const size_t WORKS = 256;
+static const size_t OPS = 20000; // 每个线程的alloc/free次数
+static const size_t LIVE = 16; // 每个线程同时持有的对象数
+
+template<typename Alloc, typename Free>
+static void run(const char* name, Alloc allocFn, Free freeFn) {
+    std::atomic<size_t> finished(0);
+    std::atomic<bool> exitFlag(false);
+    size_t rssBefore = BenchUtil::currentRSS();
+    uint64_t workNs = 0;
+    uint64_t start = BenchUtil::nowNs();
+    std::vector<std::thread> threads(WORKS);
+    for(size_t i = 0; i < WORKS; ++i){
+        threads[i] = std::thread([&, i](){
+            uint64_t state = 0x9e3779b97f4a7c15ULL + i;
+            void* live[LIVE] = {nullptr};
+            size_t sizes[LIVE] = {0};
+            for(size_t k = 0; k < OPS; ++k){
+                size_t slot = k % LIVE;
+                if(live[slot] != nullptr) freeFn(live[slot], sizes[slot]);
+                sizes[slot] = BenchUtil::nextRand(state) % 4096 + 1;
+                live[slot] = allocFn(sizes[slot]);
+            }
+            for(size_t slot = 0; slot < LIVE; ++slot){
+                freeFn(live[slot], sizes[slot]);
+            }
+            finished.fetch_add(1);
+            while(!exitFlag.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1)); // 线程保持存活但空闲
+        });
+    }
+    while(finished.load() < WORKS) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    workNs = BenchUtil::nowNs() - start;
+    size_t rssIdle = BenchUtil::currentRSS(); // 所有线程空闲但存活时，缓存中的内存都还在
+    exitFlag.store(true);
+    for(auto& t : threads) t.join();
+    printf("%-12s %10.2f Mops/s   线程空闲时RSS增长 %8zu KB   CpuCache缓存 %8zu KB\n", name,
+        WORKS * OPS * 2 * 1000.0 / workNs, (rssIdle - rssBefore) / 1024, CpuCache::getInstance().cachedBytes() / 1024);
+}
+
+template<typename Fn>
+static void forked(Fn fn) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if(pid == 0){
+        fn();
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+}
+
+int main() {
+    printf("%zu个线程，每线程%zu次alloc/free，对象大小1~4096B\n", WORKS, OPS);
+    forked([](){ run("ThreadCache", [](size_t size){ return localAllocate(size); }, [](void* ptr, size_t size){ localDeallocate(ptr, size); }); });
+    forked([](){ run("CpuCache", [](size_t size){ return localCpuAllocate(size); }, [](void* ptr, size_t size){ localCpuDeallocate(ptr, size); }); });
+    return 0;
+}
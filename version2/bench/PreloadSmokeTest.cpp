@@ -0,0 +1,111 @@
+// LD_PRELOAD冒烟测试：只使用标准分配接口，由preload_check目标在替换库下运行
+// 覆盖多线程混合分配释放、realloc、calloc、各种对齐分配、对齐的new以及fork后在子进程中分配
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <malloc.h>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "BenchUtil.h"
+
+using BenchUtil::nextRand;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+    if(!(cond)) { fprintf(stderr, "check failed: %s (line %d)\n", #cond, __LINE__); failures++; } \
+} while(0)
+
+struct alignas(256) Aligned256 {
+    char data[300];
+};
+
+static void mixedWork(uint64_t seed) {
+    std::vector<std::pair<unsigned char*, size_t>> live;
+    for(int i = 0; i < 20000; i++) {
+        if(live.size() < 256 && (nextRand(seed) & 1)) {
+            size_t size = nextRand(seed) % 2000 + 1;
+            if(nextRand(seed) % 64 == 0) size = nextRand(seed) % (1 << 20) + 1; // 偶尔分配大对象
+            unsigned char* ptr = static_cast<unsigned char*>(malloc(size));
+            memset(ptr, (int)(size & 0xff), size);
+            live.push_back({ptr, size});
+        } else if(!live.empty()) {
+            size_t k = nextRand(seed) % live.size();
+            CHECK(live[k].first[live[k].second - 1] == (unsigned char)(live[k].second & 0xff));
+            if(nextRand(seed) % 4 == 0) { // 扩大后内容保持不变
+                size_t newSize = live[k].second * 2;
+                live[k].first = static_cast<unsigned char*>(realloc(live[k].first, newSize));
+                CHECK(live[k].first[live[k].second - 1] == (unsigned char)(live[k].second & 0xff));
+                memset(live[k].first, (int)(newSize & 0xff), newSize);
+                live[k].second = newSize;
+                continue;
+            }
+            free(live[k].first);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    for(auto& item : live) free(item.first);
+}
+
+int main() {
+    std::vector<std::thread> threads;
+    for(uint64_t t = 0; t < 4; t++) {
+        threads.emplace_back(mixedWork, t * 7919 + 1);
+    }
+    for(auto& thread : threads) thread.join();
+
+    for(size_t count : {1, 100, 5000, 200000}) {
+        int* zeros = static_cast<int*>(calloc(count, sizeof(int)));
+        bool allZero = true;
+        for(size_t i = 0; i < count; i++) allZero = allZero && zeros[i] == 0;
+        CHECK(allZero);
+        memset(zeros, 0xff, count * sizeof(int));
+        free(zeros);
+    }
+
+    for(size_t align = 16; align <= (1 << 20); align <<= 1) {
+        for(size_t size : {(size_t)1, (size_t)100, (size_t)5000, (size_t)600000}) {
+            void* ptr = nullptr;
+            CHECK(posix_memalign(&ptr, align, size) == 0);
+            CHECK(((uintptr_t)ptr & (align - 1)) == 0);
+            CHECK(malloc_usable_size(ptr) >= size);
+            memset(ptr, 0x5a, size);
+            free(ptr);
+            ptr = aligned_alloc(align, size);
+            CHECK(((uintptr_t)ptr & (align - 1)) == 0);
+            free(ptr);
+        }
+    }
+
+    Aligned256* objects = new Aligned256[10];
+    CHECK(((uintptr_t)objects & 255) == 0);
+    delete[] objects;
+
+    std::string text;
+    for(int i = 0; i < 10000; i++) text += std::to_string(i);
+    CHECK(text.size() > 10000);
+
+    pid_t pid = fork(); // 子进程中分配释放不会因为继承到被锁住的锁而死锁
+    if(pid == 0) {
+        std::vector<void*> ptrs;
+        for(int i = 0; i < 1000; i++) ptrs.push_back(malloc(i + 1));
+        for(void* ptr : ptrs) free(ptr);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    if(failures != 0) {
+        printf("PreloadSmokeTest: %d checks failed\n", failures);
+        return 1;
+    }
+    printf("PreloadSmokeTest: ok\n");
+    return 0;
+}
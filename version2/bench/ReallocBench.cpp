@@ -0,0 +1,90 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace MyMemoryPool;
+
+// 缓冲区逐步增长的两种典型模式：
+// vector: 容量按1.5倍增长到32MB，跨过大对象阈值后主要考验大Span能否原地扩展
+// string: 每次追加16字节增长到64KB，大多数增长落在同一个size class内
+// 对比localReallocate、不做原地判断的"分配+拷贝+释放"以及glibc realloc
+static const size_t VECTOR_ROUNDS = 200;
+static const size_t VECTOR_MAX = 32 * 1024 * 1024;
+static const size_t STRING_ROUNDS = 200;
+static const size_t STRING_STEP = 16;
+static const size_t STRING_MAX = 64 * 1024;
+
+static size_t growCount = 0; // 调整大小的总次数
+static size_t moveCount = 0; // 其中返回了新地址的次数
+
+static void* copyGrow(void* ptr, size_t oldSize, size_t newSize) { // 没有realloc时的写法
+    void* newPtr = localAllocate(newSize);
+    if(ptr == nullptr) return newPtr;
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    localDeallocate(ptr, oldSize);
+    return newPtr;
+}
+
+template<typename Grow, typename Free>
+static uint64_t vectorGrowth(Grow growFn, Free freeFn) {
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t r = 0; r < VECTOR_ROUNDS; ++r){
+        size_t cap = 16;
+        char* buf = static_cast<char*>(growFn(nullptr, 0, cap));
+        buf[0] = 1;
+        while(cap < VECTOR_MAX){
+            size_t newCap = cap + cap / 2;
+            char* newBuf = static_cast<char*>(growFn(buf, cap, newCap));
+            growCount++;
+            if(newBuf != buf) moveCount++;
+            buf = newBuf;
+            buf[newCap - 1] = 1; // 只触碰末尾，测量的是分配和拷贝而不是缺页
+            cap = newCap;
+        }
+        freeFn(buf, cap);
+    }
+    return BenchUtil::nowNs() - start;
+}
+
+template<typename Grow, typename Free>
+static uint64_t stringGrowth(Grow growFn, Free freeFn) {
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t r = 0; r < STRING_ROUNDS; ++r){
+        size_t len = STRING_STEP;
+        char* buf = static_cast<char*>(growFn(nullptr, 0, len));
+        memset(buf, 'a', len);
+        while(len < STRING_MAX){
+            char* newBuf = static_cast<char*>(growFn(buf, len, len + STRING_STEP));
+            growCount++;
+            if(newBuf != buf) moveCount++;
+            buf = newBuf;
+            memset(buf + len, 'a', STRING_STEP);
+            len += STRING_STEP;
+        }
+        freeFn(buf, len);
+    }
+    return BenchUtil::nowNs() - start;
+}
+
+template<typename Grow, typename Free>
+static void bench(const char* name, Grow growFn, Free freeFn) {
+    growCount = moveCount = 0;
+    uint64_t vectorNs = vectorGrowth(growFn, freeFn);
+    printf("%-8s %-12s %10.1f ns/grow   拷贝比例 %6.2f%%\n", "vector", name,
+        (double)vectorNs / growCount, 100.0 * moveCount / growCount);
+    growCount = moveCount = 0;
+    uint64_t stringNs = stringGrowth(growFn, freeFn);
+    printf("%-8s %-12s %10.1f ns/grow   拷贝比例 %6.2f%%\n", "string", name,
+        (double)stringNs / growCount, 100.0 * moveCount / growCount);
+}
+
+int main() {
+    bench("glibc", [](void* ptr, size_t, size_t newSize){ return realloc(ptr, newSize); },
+        [](void* ptr, size_t){ free(ptr); });
+    bench("copy", [](void* ptr, size_t oldSize, size_t newSize){ return copyGrow(ptr, oldSize, newSize); },
+        [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+    bench("pool", [](void* ptr, size_t oldSize, size_t newSize){ return localReallocate(ptr, oldSize, newSize); },
+        [](void* ptr, size_t size){ localDeallocate(ptr, size); });
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 生产者/消费者流水线：生产者分配小对象、按批交给消费者，消费者读取后释放
+// 关闭跨线程释放时，消费者释放的内存块先进入自己的ThreadCache，超长后经CentralCache回到生产者；
+// 开启后直接放入生产者的队列，由生产者在缺少内存块时整批取回
+// 输出吞吐、生产者每千次分配向CentralCache申请的次数，以及运行期间ThreadCache与跨线程释放队列中缓存字节数的峰值（内存漂移）
+static const size_t PRODUCERS = 2;
+static const size_t CONSUMERS = 2;
+static const size_t OBJECTS = 2000000; // 每个生产者分配的对象数
+static const size_t BATCH = 64; // 每次交给消费者的对象数
+static const size_t MAX_QUEUED = 64; // 队列中最多积压的批数，超过后生产者等待
+
+struct Pipeline {
+    std::mutex _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+    std::deque<std::vector<void*>> _batches; // std::vector使用系统的malloc，不影响内存池的统计
+    size_t _producersLeft = PRODUCERS;
+};
+
+static void producer(Pipeline& pipe, size_t id) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL + id;
+    std::vector<void*> batch;
+    batch.reserve(BATCH);
+    for(size_t k = 0; k < OBJECTS; ++k){
+        size_t size = 16 + BenchUtil::nextRand(state) % 1008;
+        void* ptr = localAllocate(size);
+        *static_cast<size_t*>(ptr) = size; // 消费者按记录的大小释放
+        batch.push_back(ptr);
+        if(batch.size() == BATCH || k + 1 == OBJECTS){
+            std::unique_lock<std::mutex> lock(pipe._mutex);
+            pipe._notFull.wait(lock, [&]{ return pipe._batches.size() < MAX_QUEUED; });
+            pipe._batches.push_back(std::move(batch));
+            pipe._notEmpty.notify_one();
+            batch.clear();
+            batch.reserve(BATCH);
+        }
+    }
+    std::lock_guard<std::mutex> lock(pipe._mutex);
+    if(--pipe._producersLeft == 0) pipe._notEmpty.notify_all();
+}
+
+static void consumer(Pipeline& pipe) {
+    for(;;){
+        std::vector<void*> batch;
+        {
+            std::unique_lock<std::mutex> lock(pipe._mutex);
+            pipe._notEmpty.wait(lock, [&]{ return !pipe._batches.empty() || pipe._producersLeft == 0; });
+            if(pipe._batches.empty()) return;
+            batch = std::move(pipe._batches.front());
+            pipe._batches.pop_front();
+            pipe._notFull.notify_one();
+        }
+        for(void* ptr : batch) localDeallocate(ptr, *static_cast<size_t*>(ptr));
+    }
+}
+
+static void run(bool remote) {
+    releaseFreeMemory();
+    setRemoteFreeMode(remote);
+    PoolStats before;
+    getPoolStats(before);
+    uint64_t fetchesBefore = 0;
+    for(size_t i = 0; i < FREE_LIST_SIZE; ++i) fetchesBefore += before._classes[i]._fetches;
+
+    Pipeline pipe;
+    std::atomic<bool> done{false};
+    size_t peakCached = 0, peakQueued = 0;
+    std::thread sampler([&]{ // 每5ms采样一次缓存的字节数
+        while(!done.load()){
+            PoolStats stats;
+            getPoolStats(stats);
+            peakCached = std::max(peakCached, stats._threadCacheBytes);
+            peakQueued = std::max(peakQueued, stats._remoteFreeBytes);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+    uint64_t start = BenchUtil::nowNs();
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < PRODUCERS; ++i) threads.emplace_back([&, i]{ producer(pipe, i); });
+    for(size_t i = 0; i < CONSUMERS; ++i) threads.emplace_back([&]{ consumer(pipe); });
+    for(auto& t : threads) t.join();
+    uint64_t ns = BenchUtil::nowNs() - start;
+    done = true;
+    sampler.join();
+
+    PoolStats after;
+    getPoolStats(after);
+    uint64_t fetches = 0;
+    for(size_t i = 0; i < FREE_LIST_SIZE; ++i) fetches += after._classes[i]._fetches;
+    fetches -= fetchesBefore;
+    printf("%-6s %10.2f Mops/s %14.2f %14zu KB %14zu KB %14llu\n", remote ? "开启" : "关闭",
+        PRODUCERS * OBJECTS * 1000.0 / ns, fetches * 1000.0 / (PRODUCERS * OBJECTS), peakCached >> 10, peakQueued >> 10,
+        (unsigned long long)(after._remoteFrees - before._remoteFrees));
+}
+
+int main() {
+    printf("%zu个生产者各分配%zu个16B~1KB的对象，每%zu个一批交给%zu个消费者释放\n", PRODUCERS, OBJECTS, BATCH, CONSUMERS);
+    printf("%-6s %17s %14s %17s %17s %14s\n", "跨线程", "throughput", "fetches/1k", "peak cached", "peak queued", "remote frees");
+    run(false);
+    run(true);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <cstring>
+
+using namespace MyMemoryPool;
+
+// 模拟一次流量高峰：申请大量内存后全部释放，观察RSS在显式回收/后台回收后的变化，以及回收后再次使用的开销
+static const size_t SPIKE_BYTES = 256 * 1024 * 1024;
+
+static double spike(std::vector<void*>& ptrs, size_t objSize) { // 申请并写满SPIKE_BYTES，返回平均每个对象的耗时(ns)
+    size_t count = SPIKE_BYTES / objSize;
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t k = 0; k < count; ++k){
+        void* ptr = localAllocate(objSize);
+        memset(ptr, 1, objSize);
+        ptrs.push_back(ptr);
+    }
+    return (double)(BenchUtil::nowNs() - start) / count;
+}
+
+static void release(std::vector<void*>& ptrs, size_t objSize) {
+    for(void* ptr : ptrs){
+        localDeallocate(ptr, objSize);
+    }
+    ptrs.clear();
+}
+
+static void report(const char* stage) {
+    printf("%-28s RSS: %8zu KB\n", stage, BenchUtil::currentRSS() / 1024);
+}
+
+int main() {
+    std::vector<void*> ptrs;
+    size_t sizes[] = {256, 64 * 1024, 4 * 1024 * 1024};
+    for(size_t objSize : sizes){
+        printf("------------ 对象大小 %zu B ------------\n", objSize);
+        double first = spike(ptrs, objSize);
+        report("高峰期");
+        release(ptrs, objSize);
+        report("全部释放后");
+        size_t pages = releaseFreeMemory();
+        printf("releaseFreeMemory归还%zu页\n", pages);
+        report("releaseFreeMemory后");
+        double refault = spike(ptrs, objSize);
+        report("复用已归还的页后");
+        printf("首次申请 %.1f ns/obj，复用已归还的页 %.1f ns/obj\n", first, refault);
+        release(ptrs, objSize);
+        releaseFreeMemory();
+    }
+
+    printf("------------ 后台回收线程(空闲100ms，每50ms检查) ------------\n");
+    startScavenger(100, 50);
+    spike(ptrs, 64 * 1024);
+    release(ptrs, 64 * 1024);
+    ptrTLSThreadCache->releaseAll();
+    report("释放后立即");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    report("等待300ms后");
+    stopScavenger();
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// CentralCache选取Span的开销和碎片：
+//   scan: 单线程分配SCAN_OBJECTS个64B对象，在最早分配的20%中隔一个释放一个并归还到CentralCache，
+//         再分批取回这些对象；有空闲内存块的Span只占一小部分且都是最早的Span，取用时不应逐个跳过已分完的Span
+//   churn: 多个线程长时间随机分配释放16B~512B的对象，存活集合在MAX_LIVE和MAX_LIVE / 4之间交替增长和收缩，
+//          最后收缩到MAX_LIVE / 4并保持STEADY_OPS次操作，统计CentralCache持有的Span字节数、其中空闲的字节数和RSS
+//     uniform: 随机释放任意存活对象；young: 释放大多落在最近分配的对象上
+//     -notc: 关闭TransferCache，释放的内存块都回到所属Span，只比较Span的选取策略
+//   drain: 分配DRAIN_SPANS个Span的1KB对象，较早的一半Span各释放1/4（较满），较新的一半各只留一个对象（较空），
+//          再分配较满的Span中一半的空位，最后释放较空的Span中留下的对象。新分配都落在较满的Span上时，
+//          较空的Span最后整体回到PageCache；按链表顺序或从较空的Span取用时它们会被重新填上。检查剩下的Span数，不符时返回非0
+static const size_t SCAN_OBJECTS = 1 << 20;
+static const size_t SCAN_BATCH = 256;
+static const size_t THREADS = 4;
+static const size_t OPS = 6000000; // 每个线程的操作数
+static const size_t STEADY_OPS = 2000000;
+static const size_t MAX_LIVE = 200000; // 每个线程存活对象数的上限
+static const size_t DRAIN_SIZE = 1024;
+static const size_t DRAIN_SPANS = 64;
+
+struct Live {
+    void* _ptr;
+    size_t _size;
+};
+
+static std::vector<Live> survivors[THREADS]; // 各线程结束时仍存活的对象，线程退出后由主线程统计并释放
+
+static void scanBench() {
+    std::vector<void*> ptrs(SCAN_OBJECTS);
+    for(size_t i = 0; i < SCAN_OBJECTS; ++i) ptrs[i] = localAllocate(64);
+    size_t freed = SCAN_OBJECTS / 10;
+    std::vector<void*> holes(freed);
+    for(size_t i = 0; i < freed; ++i) { // 每个Span只空出一半，不会整体回到PageCache
+        holes[i] = ptrs[i * 2];
+        localDeallocate(holes[i], 64);
+    }
+    releaseFreeMemory(); // 本线程缓存的内存块全部归还到Span
+    uint64_t start = BenchUtil::nowNs();
+    for(size_t i = 0; i < freed; i += SCAN_BATCH) {
+        size_t n = std::min(SCAN_BATCH, freed - i);
+        if(localAllocateBatch(64, n, holes.data() + i) != n) abort();
+    }
+    uint64_t ns = BenchUtil::nowNs() - start;
+    printf("scan: 共%zu个64B对象，取回最早的Span中空出的%zu个: %.2f ns/object\n", SCAN_OBJECTS, freed, (double)ns / freed);
+    for(size_t i = 0; i < freed; ++i) ptrs[i * 2] = holes[i];
+    for(size_t i = 0; i < SCAN_OBJECTS; ++i) localDeallocate(ptrs[i], 64);
+    releaseFreeMemory();
+}
+
+static void churn(size_t id, bool youngFirst) {
+    uint64_t state = 0x9e3779b97f4a7c15ULL + id;
+    std::vector<Live> live;
+    live.reserve(MAX_LIVE);
+    bool growing = true;
+    size_t steady = 0; // 收缩到MAX_LIVE / 4之后保持存活对象数不变的操作数
+    for(size_t op = 0; op < OPS || live.size() > MAX_LIVE / 4 || steady < STEADY_OPS; ++op) {
+        if(live.size() >= MAX_LIVE) growing = false;
+        if(live.size() <= MAX_LIVE / 4) growing = op < OPS;
+        uint64_t r = BenchUtil::nextRand(state);
+        uint64_t allocPercent = growing ? 70 : 30; // 增长时70%的操作是分配，收缩时30%
+        if(op >= OPS && live.size() <= MAX_LIVE / 4) { // 最后一次收缩完成，分配和释放各占一半
+            allocPercent = 50;
+            steady++;
+        }
+        if(live.empty() || r % 100 < allocPercent) {
+            size_t size = 16 + (r >> 8) % 497;
+            void* ptr = localAllocate(size);
+            *static_cast<char*>(ptr) = 1;
+            live.push_back(Live{ptr, size});
+        }else { // 随机释放一个存活对象，使空闲内存块分散在各个Span中
+            size_t k = (r >> 8) % live.size();
+            if(youngFirst && (r >> 40) % 4 != 0) k = live.size() - 1 - (r >> 8) % (live.size() / 4 + 1); // 3/4的释放落在最近分配的1/4中
+            localDeallocate(live[k]._ptr, live[k]._size);
+            live[k] = live.back();
+            live.pop_back();
+        }
+    }
+    survivors[id] = std::move(live);
+}
+
+static void churnBench(const char* name, bool youngFirst) {
+    size_t rssStart = BenchUtil::currentRSS();
+    uint64_t ns = BenchUtil::runThreads(THREADS, [youngFirst](size_t id){ churn(id, youngFirst); });
+    size_t liveBytes = 0;
+    for(size_t t = 0; t < THREADS; ++t) {
+        for(const Live& live : survivors[t]) liveBytes += live._size;
+    }
+    PoolStats* stats = new PoolStats; // 快照较大，不放在栈上
+    getPoolStats(*stats);
+    size_t spans = 0, spanBytes = 0, centralBytes = 0;
+    for(size_t i = 0; i < FREE_LIST_SIZE; ++i) {
+        const SizeClassStats& cls = stats->_classes[i];
+        if(cls._spans == 0) continue;
+        spans += cls._spans;
+        spanBytes += cls._spans * (SizeClass::normPageNum(cls._objSize) << PAGE_SHIFT);
+        centralBytes += cls._centralCacheBytes;
+    }
+    delete stats;
+    printf("churn-%s: %zu个线程，每线程约%zu次操作: %.2f ns/op\n", name, THREADS, OPS, (double)ns / (THREADS * OPS));
+    printf("  存活对象: %zu KB\n", liveBytes / 1024);
+    printf("  CentralCache: %zu个Span共%zu KB，其中空闲%zu KB (%.1f%%)\n",
+           spans, spanBytes / 1024, centralBytes / 1024, spanBytes == 0 ? 0.0 : 100.0 * centralBytes / spanBytes);
+    size_t rssBefore = BenchUtil::currentRSS();
+    releaseFreeMemory();
+    size_t rssAfter = BenchUtil::currentRSS();
+    printf("  RSS: 开始%zu KB，收缩后%zu KB，releaseFreeMemory后%zu KB\n", rssStart / 1024, rssBefore / 1024, rssAfter / 1024);
+    for(size_t t = 0; t < THREADS; ++t) {
+        for(const Live& live : survivors[t]) localDeallocate(live._ptr, live._size);
+        survivors[t].clear();
+    }
+    releaseFreeMemory();
+}
+
+static size_t classSpans(size_t index) { // 该size class在CentralCache中的Span数
+    PoolStats* stats = new PoolStats;
+    getPoolStats(*stats);
+    size_t spans = stats->_classes[index]._spans;
+    delete stats;
+    return spans;
+}
+
+static bool drainBench() {
+    size_t index = SizeClass::getIndex(DRAIN_SIZE);
+    size_t capacity = (SizeClass::normPageNum(DRAIN_SIZE) << PAGE_SHIFT) / SizeClass::classSize(index);
+    size_t spansBefore = classSpans(index);
+    std::vector<void*> ptrs(DRAIN_SPANS * capacity);
+    if(localAllocateBatch(DRAIN_SIZE, ptrs.size(), ptrs.data()) != ptrs.size()) abort();
+    releaseFreeMemory(); // 多取的内存块归还到Span
+    std::vector<std::vector<void*>> spans; // 按取用顺序分组，只保留内存块全部在本线程手中的Span
+    std::vector<void*> others;
+    for(size_t i = 0; i < ptrs.size(); ) {
+        SpanList::Span* span = PageCache::getIdOfSpan(ptrs[i]);
+        size_t j = i;
+        while(j < ptrs.size() && PageCache::getIdOfSpan(ptrs[j]) == span) j++;
+        if(j - i == capacity) spans.emplace_back(ptrs.begin() + i, ptrs.begin() + j);
+        else others.insert(others.end(), ptrs.begin() + i, ptrs.begin() + j);
+        i = j;
+    }
+    size_t dense = spans.size() / 2;
+    size_t holes = 0;
+    for(size_t s = 0; s < spans.size(); ++s) {
+        size_t keep = s < dense ? capacity - capacity / 4 : 1;
+        for(size_t k = keep; k < capacity; ++k) localDeallocate(spans[s][k], DRAIN_SIZE);
+        spans[s].resize(keep);
+        if(s < dense) holes += capacity - keep;
+    }
+    releaseFreeMemory();
+    std::vector<void*> refill(holes / 2); // 留出余量，ThreadCache多取的一批也不会超出较满的Span中的空位
+    if(localAllocateBatch(DRAIN_SIZE, refill.size(), refill.data()) != refill.size()) abort();
+    for(size_t s = dense; s < spans.size(); ++s) { // 较空的Span中最后的对象
+        localDeallocate(spans[s][0], DRAIN_SIZE);
+        spans[s].clear();
+    }
+    releaseFreeMemory();
+    size_t remaining = classSpans(index) - spansBefore;
+    printf("drain: %zu个Span（每个%zu个%zuB对象），%zu个较满、%zu个较空，回填%zu个后剩下%zu个Span\n",
+           spans.size(), capacity, DRAIN_SIZE, dense, spans.size() - dense, refill.size(), remaining);
+    for(size_t s = 0; s < dense; ++s) {
+        for(void* ptr : spans[s]) localDeallocate(ptr, DRAIN_SIZE);
+    }
+    for(void* ptr : refill) localDeallocate(ptr, DRAIN_SIZE);
+    for(void* ptr : others) localDeallocate(ptr, DRAIN_SIZE);
+    releaseFreeMemory();
+    if(remaining > dense) {
+        printf("FAILED: 较空的Span没有全部回到PageCache\n");
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    if(!drainBench()) return 1;
+    scanBench();
+    churnBench("uniform", false);
+    churnBench("young", true);
+    CentralCache::getInstance().setTransferCacheEnabled(false);
+    churnBench("uniform-notc", false);
+    churnBench("young-notc", true);
+    return 0;
+}
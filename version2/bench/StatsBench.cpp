@@ -0,0 +1,60 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// 统计计数器的开销：同一份源码分别链接memorypool(StatsBench)和去掉计数器的memorypool_nostats(StatsBench_nostats)
+// 两个程序输出的ns/op之差即为ThreadCache快速路径上计数器的开销
+static const size_t ROUNDS = 100;
+static const size_t ITERATIONS = 10000;
+
+static size_t sizeOf(size_t k) { // 8B~1KB的小对象混合，基本都命中ThreadCache
+    return (k * 37) % 1024 + 1;
+}
+
+static double bench(size_t works) {
+    uint64_t ns = BenchUtil::runThreads(works, [](size_t){
+        std::vector<void*> ptrVec(ITERATIONS);
+        for(size_t j = 0; j < ROUNDS; ++j){
+            for(size_t k = 0; k < ITERATIONS; ++k){
+                ptrVec[k] = localAllocate(sizeOf(k));
+            }
+            for(size_t k = 0; k < ITERATIONS; ++k){
+                localDeallocate(ptrVec[k], sizeOf(k));
+            }
+        }
+    });
+    return (double)ns / (works * ROUNDS * ITERATIONS);
+}
+
+int main() {
+#ifdef MEMORYPOOL_NO_STATS
+    const char* mode = "stats off";
+#else
+    const char* mode = "stats on";
+#endif
+    bench(1); // 预热
+    printf("%-10s %-8s %14s\n", "mode", "threads", "ns/op");
+    for(size_t works = 1; works <= 4; works *= 2){
+        double best = bench(works);
+        for(int i = 0; i < 2; i++){ // 取三次中的最好成绩，减小调度带来的抖动
+            double cost = bench(works);
+            if(cost < best) best = cost;
+        }
+        printf("%-10s %-8zu %14.2f\n", mode, works, best);
+    }
+
+    std::vector<void*> live; // 保留一部分对象，让统计输出中各层都有内容
+    for(size_t k = 0; k < 5000; ++k) live.push_back(localAllocate(sizeOf(k)));
+    void* large = localAllocate(MAX_BYTES + 1);
+    uint64_t start = BenchUtil::nowNs();
+    PoolStats stats;
+    getPoolStats(stats);
+    printf("getPoolStats耗时: %.1f us\n", (BenchUtil::nowNs() - start) / 1000.0);
+    printPoolStats(std::cout, stats, false);
+    printPoolStats(std::cout, stats, true);
+    localDeallocate(large, MAX_BYTES + 1);
+    for(size_t k = 0; k < live.size(); ++k) localDeallocate(live[k], sizeOf(k));
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// ThreadCache容量预算：若干空闲线程先做一轮突发分配后一直存活，另外几个忙线程持续做混合大小的分配释放
+// 忙线程的缓存超出容量后会从空闲线程处窃取，输出不同预算下的吞吐以及所有ThreadCache缓存的字节数
+// 空闲线程被窃取的容量中仍被缓存占用的部分，要等它归还内存后才能被使用，因此缓存总量不超过预算
+// （线程数乘以最小容量更大时为后者）加上每个线程一批：线程在两次释放之间可能多取一批，超出时返回非0
+static const size_t IDLE_WORKS = 6;
+static const size_t BUSY_WORKS = 2;
+static const size_t IDLE_BURST = 20000; // 空闲线程突发分配的对象数
+static const size_t BUSY_OPS = 2000000; // 每个忙线程的分配次数
+static const size_t LIVE = 1024; // 忙线程同时持有的对象数
+
+static size_t mixedSize(uint64_t& state) { // 70%小对象，25%中等对象，5%较大对象
+    uint64_t r = BenchUtil::nextRand(state);
+    size_t pick = r % 100;
+    r >>= 8;
+    if(pick < 70) return 8 + r % 248;
+    if(pick < 95) return 256 + r % (8 * 1024 - 256);
+    return 8 * 1024 + r % (256 * 1024 - 8 * 1024);
+}
+
+static bool run(size_t budget) {
+    setThreadCacheBudget(budget);
+    std::atomic<size_t> idleReady{0};
+    std::atomic<bool> busyDone{false};
+    std::vector<std::thread> idle;
+    for(size_t i = 0; i < IDLE_WORKS; ++i){
+        idle.emplace_back([&, i]{
+            uint64_t state = 0x9e3779b97f4a7c15ULL + i;
+            std::vector<void*> ptrs(IDLE_BURST);
+            std::vector<size_t> sizes(IDLE_BURST);
+            for(size_t k = 0; k < IDLE_BURST; ++k){
+                sizes[k] = mixedSize(state);
+                ptrs[k] = localAllocate(sizes[k]);
+            }
+            for(size_t k = 0; k < IDLE_BURST; ++k) localDeallocate(ptrs[k], sizes[k]);
+            idleReady++;
+            while(!busyDone.load()) std::this_thread::sleep_for(std::chrono::milliseconds(1)); // 保持存活，缓存不会被线程退出回收
+        });
+    }
+    while(idleReady.load() < IDLE_WORKS) std::this_thread::yield();
+
+    std::atomic<bool> withinBudget{true};
+    uint64_t ns = BenchUtil::runThreads(BUSY_WORKS, [&](size_t id){
+        uint64_t state = 0x2545f4914f6cdd1dULL + id;
+        void* ptrs[LIVE] = {nullptr};
+        size_t sizes[LIVE] = {0};
+        for(size_t k = 0; k < BUSY_OPS; ++k){
+            size_t slot = BenchUtil::nextRand(state) % LIVE;
+            if(ptrs[slot] != nullptr) localDeallocate(ptrs[slot], sizes[slot]);
+            sizes[slot] = mixedSize(state);
+            ptrs[slot] = localAllocate(sizes[slot]);
+        }
+        for(size_t slot = 0; slot < LIVE; ++slot){
+            if(ptrs[slot] != nullptr) localDeallocate(ptrs[slot], sizes[slot]);
+        }
+        if(id == 0) { // 忙线程退出前的快照，此时所有线程都还存活
+            PoolStats* stats = new PoolStats; // 快照较大，不放在栈上
+            getPoolStats(*stats);
+            printf("%10zu KB %10zu KB %10zu KB", stats->_threadCacheBudget >> 10, stats->_threadCacheBytes >> 10, stats->_threadCacheLimit >> 10);
+            size_t budget = std::max<size_t>(stats->_threadCacheBudget, stats->_threads * MIN_THREAD_CACHE_SIZE);
+            size_t maxBatchBytes = SizeClass::normBatchNum(MAX_BYTES) * MAX_BYTES; // 最大的size class一批的字节数
+            if(stats->_threadCacheBytes > budget + stats->_threads * maxBatchBytes) withinBudget = false;
+            delete stats;
+        }
+    });
+    printf(" %10.2f Mops/s\n", BUSY_WORKS * BUSY_OPS * 1000.0 / ns);
+    busyDone = true;
+    for(auto& t : idle) t.join();
+    if(!withinBudget) printf("FAILED: 缓存总量超过预算加上每个线程一批\n");
+    return withinBudget;
+}
+
+int main() {
+    printf("%zu个空闲线程各突发分配%zu个对象后保持存活，%zu个忙线程各做%zu次8B~256KB的混合分配释放\n",
+        IDLE_WORKS, IDLE_BURST, BUSY_WORKS, BUSY_OPS);
+    printf("%13s %13s %13s %17s\n", "budget", "cached", "limit", "throughput");
+    size_t budgets[] = {4 << 20, 16 << 20, 64 << 20, 256 << 20};
+    bool ok = true;
+    for(size_t budget : budgets) ok = run(budget) && ok;
+    return ok ? 0 : 1;
+}
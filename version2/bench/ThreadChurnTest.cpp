@@ -0,0 +1,66 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// 反复创建、销毁线程，检查线程退出后ThreadCache中的内存能够被回收，RSS保持平稳
+// 每轮结束后还检查内存池自身的统计：不再有存活的ThreadCache，缓存的字节数归零，预热后向系统申请的字节数不超过MAX_GROWTH
+// RSS还包含线程栈等不属于内存池的部分，统计值则只取决于内存池，不随线程调度波动
+static const size_t ROUNDS = 8; // 轮数
+static const size_t THREADS_PER_ROUND = 500; // 每轮创建的线程数，分批并发
+static const size_t CONCURRENCY = 8; // 同时存活的线程数
+static const size_t OBJECTS = 256; // 每个线程分配的对象数
+static const size_t MAX_GROWTH = 8 * 1024 * 1024; // 预热后允许的RSS增长和向系统申请内存的增长上限
+
+static void worker() {
+    void* ptrs[OBJECTS];
+    for(size_t k = 0; k < OBJECTS; ++k){
+        ptrs[k] = localAllocate((k * 37) % 2048 + 1);
+    }
+    for(size_t k = 0; k < OBJECTS; ++k){
+        localDeallocate(ptrs[k]); // 释放后留在本线程的ThreadCache中，线程退出时才归还
+    }
+}
+
+static void runRound() {
+    for(size_t i = 0; i < THREADS_PER_ROUND; i += CONCURRENCY){
+        BenchUtil::runThreads(CONCURRENCY, [](size_t){ worker(); });
+    }
+}
+
+static bool checkPool(const PoolStats& stats, size_t mappedBaseline) { // 线程全部退出后内存池的状态
+    if(stats._threads != 0 || stats._threadCacheBytes != 0) {
+        printf("FAILED: 线程退出后仍有%zu个ThreadCache，缓存%zu KB\n", stats._threads, stats._threadCacheBytes / 1024);
+        return false;
+    }
+    if(stats._mappedBytes > mappedBaseline + MAX_GROWTH) {
+        printf("FAILED: 向系统申请的内存增长%zu KB，超过上限%zu KB\n", (stats._mappedBytes - mappedBaseline) / 1024, MAX_GROWTH / 1024);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    PoolStats* stats = new PoolStats; // 快照较大，不放在栈上
+    runRound(); // 预热：让CentralCache/PageCache以及线程栈缓存达到稳定状态
+    getPoolStats(*stats);
+    size_t mappedBaseline = stats->_mappedBytes;
+    size_t baseline = BenchUtil::currentRSS();
+    printf("预热后RSS: %zu KB，向系统申请: %zu KB\n", baseline / 1024, mappedBaseline / 1024);
+    size_t rss = baseline;
+    for(size_t round = 1; round <= ROUNDS; ++round){
+        runRound();
+        rss = BenchUtil::currentRSS();
+        getPoolStats(*stats);
+        printf("第%zu轮(累计%zu个线程)后RSS: %zu KB，向系统申请: %zu KB\n", round, (round + 1) * THREADS_PER_ROUND, rss / 1024, stats->_mappedBytes / 1024);
+        if(!checkPool(*stats, mappedBaseline)) return 1;
+    }
+    delete stats;
+    if(rss > baseline + MAX_GROWTH){
+        printf("FAILED: RSS增长%zu KB，超过上限%zu KB\n", (rss - baseline) / 1024, MAX_GROWTH / 1024);
+        return 1;
+    }
+    printf("PASSED: RSS增长%ld KB\n", ((long)rss - (long)baseline) / 1024);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+
+using namespace MyMemoryPool;
+
+// 生产者/消费者：生产者分配对象交给消费者释放，内存持续从消费者流回生产者
+// 对比开启与关闭TransferCache时的吞吐量
+static const size_t PAIRS = 4; // 生产者-消费者对数
+static const size_t OBJECTS = 2000000; // 每个生产者分配的对象数
+static const size_t HANDOFF = 256; // 每次交接的对象数
+static const size_t OBJ_SIZE = 64;
+static const size_t QUEUE_LIMIT = 8; // 队列中最多积压的交接批数，模拟流水线的背压
+
+struct Channel { // 生产者与消费者之间按批交接指针，减少队列本身的开销
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    std::deque<std::vector<void*>> _queue;
+    bool _done = false;
+};
+
+static double bench(bool useTransferCache) {
+    CentralCache::getInstance().setTransferCacheEnabled(useTransferCache);
+    std::vector<Channel> channels(PAIRS);
+    size_t popHits = 0, popMisses = 0;
+    size_t index = SizeClass::getIndex(OBJ_SIZE);
+    size_t hitsBefore = CentralCache::getInstance().getTransferCache(index).popHits();
+    size_t missesBefore = CentralCache::getInstance().getTransferCache(index).popMisses();
+    uint64_t ns = BenchUtil::runThreads(PAIRS * 2, [&](size_t id){
+        Channel& channel = channels[id / 2];
+        if(id % 2 == 0){ // 生产者
+            std::vector<void*> batch;
+            for(size_t k = 0; k < OBJECTS; ++k){
+                batch.push_back(localAllocate(OBJ_SIZE));
+                if(batch.size() == HANDOFF){
+                    std::unique_lock<std::mutex> lock(channel._mutex);
+                    channel._cond.wait(lock, [&]{ return channel._queue.size() < QUEUE_LIMIT; });
+                    channel._queue.push_back(std::move(batch));
+                    channel._cond.notify_one();
+                    batch.clear();
+                }
+            }
+            std::lock_guard<std::mutex> lock(channel._mutex);
+            channel._done = true;
+            channel._cond.notify_one();
+        }else{ // 消费者
+            while(true){
+                std::vector<void*> batch;
+                {
+                    std::unique_lock<std::mutex> lock(channel._mutex);
+                    channel._cond.wait(lock, [&]{ return !channel._queue.empty() || channel._done; });
+                    if(channel._queue.empty()) break;
+                    batch = std::move(channel._queue.front());
+                    channel._queue.pop_front();
+                    channel._cond.notify_one(); // 唤醒可能因背压等待的生产者
+                }
+                for(void* ptr : batch) localDeallocate(ptr, OBJ_SIZE);
+            }
+        }
+    });
+    popHits = CentralCache::getInstance().getTransferCache(index).popHits() - hitsBefore;
+    popMisses = CentralCache::getInstance().getTransferCache(index).popMisses() - missesBefore;
+    double mops = PAIRS * OBJECTS * 1000.0 / ns;
+    printf("%-18s %10.2f Mops/s   TransferCache命中 %8zu 未命中 %8zu\n",
+        useTransferCache ? "TransferCache开启" : "TransferCache关闭", mops, popHits, popMisses);
+    return mops;
+}
+
+int main() {
+    printf("%zu对生产者/消费者，每个生产者分配%zu个%zuB对象\n", PAIRS, OBJECTS, OBJ_SIZE);
+    bench(false);
+    bench(true);
+    return 0;
+}
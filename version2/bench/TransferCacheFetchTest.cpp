@@ -0,0 +1,51 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 新线程第一次向CentralCache取内存块时处于慢开始阶段，只要1个；即使TransferCache中有其他线程归还的整批，
+// 也不能整批放进它的ThreadCache。先由一个线程把若干整批归还到TransferCache并退出，
+// 再让新线程分配一个对象，检查该size class在所有ThreadCache中缓存的字节数仍为0，否则返回非0
+static const size_t SIZE = 64;
+static const size_t BATCHES = 4; // 预先放入TransferCache的批次数
+
+static size_t classBytes(size_t index, bool transfer) { // 该size class在TransferCache或所有ThreadCache中缓存的字节数
+    PoolStats* stats = new PoolStats; // 快照较大，不放在栈上
+    getPoolStats(*stats);
+    size_t bytes = transfer ? stats->_classes[index]._transferCacheBytes : stats->_classes[index]._threadCacheBytes;
+    delete stats;
+    return bytes;
+}
+
+int main() {
+    size_t index = SizeClass::getIndex(SIZE);
+    size_t batchNum = SizeClass::batchNum(index);
+    BenchUtil::runThreads(1, [&](size_t){
+        // 批量分配n个后自由链表允许留下n个，分两次取2n个再一起释放，多出的n个按整批交给TransferCache
+        size_t n = BATCHES * batchNum;
+        std::vector<void*> ptrs(2 * n);
+        size_t got = localAllocateBatch(SIZE, n, ptrs.data());
+        got += localAllocateBatch(SIZE, n, ptrs.data() + got);
+        localDeallocateBatch(SIZE, got, ptrs.data());
+    });
+    size_t transferBytes = classBytes(index, true);
+    printf("TransferCache中缓存: %zu B (每批%zu个%zuB对象)\n", transferBytes, batchNum, SIZE);
+    if(transferBytes < batchNum * SIZE) {
+        printf("FAILED: TransferCache中没有整批内存块，无法检查\n");
+        return 1;
+    }
+    size_t cached = 0;
+    BenchUtil::runThreads(1, [&](size_t){
+        void* ptr = localAllocate(SIZE);
+        cached = classBytes(index, false); // 本线程还存活，它的ThreadCache计入统计
+        localDeallocate(ptr, SIZE);
+    });
+    if(cached != 0) {
+        printf("FAILED: 新线程第一次分配后ThreadCache缓存了%zu B，超过了它要的1个对象\n", cached);
+        return 1;
+    }
+    printf("PASSED: 新线程第一次分配只取了1个对象\n");
+    return 0;
+}
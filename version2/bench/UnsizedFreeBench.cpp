@@ -0,0 +1,45 @@
+#include "../include/UseMemoryPool.h"
+#include "BenchUtil.h"
+#include <cstdio>
+
+using namespace MyMemoryPool;
+
+// 对比有尺寸释放 localDeallocate(ptr, size) 与无尺寸释放 localDeallocate(ptr) 的开销
+static const size_t ROUNDS = 50;
+static const size_t ITERATIONS = 10000;
+
+static size_t sizeOf(size_t k) { // 8B~4KB的小对象混合
+    return (k * 37) % 4096 + 1;
+}
+
+static double bench(size_t works, bool sized) {
+    uint64_t ns = BenchUtil::runThreads(works, [sized](size_t){
+        std::vector<void*> ptrVec(ITERATIONS);
+        for(size_t j = 0; j < ROUNDS; ++j){
+            for(size_t k = 0; k < ITERATIONS; ++k){
+                ptrVec[k] = localAllocate(sizeOf(k));
+            }
+            if(sized){
+                for(size_t k = 0; k < ITERATIONS; ++k){
+                    localDeallocate(ptrVec[k], sizeOf(k));
+                }
+            }else{
+                for(size_t k = 0; k < ITERATIONS; ++k){
+                    localDeallocate(ptrVec[k]);
+                }
+            }
+        }
+    });
+    return (double)ns / (works * ROUNDS * ITERATIONS); // 每对alloc/free的平均耗时
+}
+
+int main() {
+    bench(1, true); // 预热，让各线程缓存和页表节点就位
+    printf("%-8s %18s %18s\n", "threads", "sized(ns/op)", "unsized(ns/op)");
+    for(size_t works = 1; works <= 8; works *= 2){
+        double sized = bench(works, true);
+        double unsized = bench(works, false);
+        printf("%-8zu %18.2f %18.2f\n", works, sized, unsized);
+    }
+    return 0;
+}
@@ -0,0 +1,416 @@
+#include "../include/UseMemoryPool.h"
+#include "../bench/BenchUtil.h"
+#include "Version1Pool.h"
+#include "PerfCounter.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+// 内存池基准测试：每个负载分别在内存池、glibc malloc和version1的BlockToHash上运行
+// 吞吐量按墙上时间(steady_clock)计算，从所有线程同时开始到全部结束；每64次操作对其中一次单独计时得到延迟分位数
+// 每次运行同时用perf计数器统计dTLB load缺失和缺页次数，计数器不可用时输出-1
+// 用法: benchmark [--format=table|csv|json] [--workload=名称] [--allocator=pool|malloc|version1]
+//                 [--threads=1,2,4,8,16] [--ops=每个线程的操作数] [--hugepages]
+
+static const uint64_t SAMPLE_MASK = 63; // 每64次操作采样一次延迟，计时本身的开销不影响吞吐量的测量
+
+struct Allocator {
+    const char* _name;
+    void* (*_allocate)(size_t);
+    void (*_deallocate)(void*, size_t);
+};
+
+static void* poolAllocate(size_t size) { return localAllocate(size); }
+static void poolDeallocate(void* ptr, size_t size) { localDeallocate(ptr, size); }
+static void* mallocAllocate(size_t size) { return malloc(size); }
+static void mallocDeallocate(void* ptr, size_t) { free(ptr); }
+
+static const Allocator ALLOCATORS[] = {
+    {"pool", poolAllocate, poolDeallocate},
+    {"malloc", mallocAllocate, mallocDeallocate},
+    {"version1", version1Allocate, version1Deallocate}, // 超过512字节时内部转给operator new
+};
+
+class Recorder { // 每个线程一个，记录操作数和采样到的单次操作耗时
+public:
+    Recorder(const Allocator& allocator, size_t ops) : _allocator(allocator) {
+        _samples.reserve(ops / (SAMPLE_MASK + 1) + 16); // 预先分配，计时期间不再扩容
+    }
+    void* allocate(size_t size) {
+        void* ptr;
+        if((++_ops & SAMPLE_MASK) != 0) {
+            ptr = _allocator._allocate(size);
+        } else {
+            uint64_t start = BenchUtil::nowNs();
+            ptr = _allocator._allocate(size);
+            _samples.push_back(BenchUtil::nowNs() - start);
+        }
+        *static_cast<char*>(ptr) = 1; // 写入一次，避免只测到从未访问过的内存
+        return ptr;
+    }
+    void deallocate(void* ptr, size_t size) {
+        if((++_ops & SAMPLE_MASK) != 0) {
+            _allocator._deallocate(ptr, size);
+        } else {
+            uint64_t start = BenchUtil::nowNs();
+            _allocator._deallocate(ptr, size);
+            _samples.push_back(BenchUtil::nowNs() - start);
+        }
+    }
+    uint64_t ops() const { return _ops; }
+    const std::vector<uint64_t>& samples() const { return _samples; }
+private:
+    const Allocator& _allocator;
+    uint64_t _ops = 0;
+    std::vector<uint64_t> _samples;
+};
+
+class Barrier { // 可重复使用的线程屏障，用于larson负载中每轮交换对象
+public:
+    explicit Barrier(size_t count) : _count(count) {}
+    void wait() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        size_t generation = _generation;
+        if(++_arrived == _count) {
+            _arrived = 0;
+            _generation++;
+            _cond.notify_all();
+        } else {
+            _cond.wait(lock, [&]{ return _generation != generation; });
+        }
+    }
+private:
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    size_t _count;
+    size_t _arrived = 0;
+    size_t _generation = 0;
+};
+
+// 创建threads个线程，全部就绪后同时开始执行fn，返回从开始到全部结束的墙上时间
+template<typename Fn>
+static uint64_t runWorkers(size_t threads, std::vector<Recorder>& recorders, Fn fn) {
+    std::atomic<size_t> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> workers;
+    for(size_t id = 0; id < threads; id++) {
+        workers.emplace_back([&, id]{
+            ready.fetch_add(1);
+            while(!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            fn(id, recorders[id]);
+        });
+    }
+    while(ready.load() != threads) std::this_thread::yield();
+    uint64_t start = BenchUtil::nowNs();
+    go.store(true, std::memory_order_release);
+    for(auto& worker : workers) worker.join();
+    return BenchUtil::nowNs() - start;
+}
+
+struct Workload {
+    const char* _name;
+    // ops为每个线程的目标操作数（分配和释放各算一次）
+    uint64_t (*_run)(size_t threads, size_t ops, std::vector<Recorder>& recorders);
+};
+
+static size_t randomSize(uint64_t& seed) { // 90%为8B~512B，9%为512B~8KB，1%为8KB~64KB
+    uint64_t r = BenchUtil::nextRand(seed);
+    uint64_t bucket = r % 100;
+    if(bucket < 90) return (r >> 8) % 505 + 8;
+    if(bucket < 99) return (r >> 8) % 7680 + 512;
+    return (r >> 8) % 57344 + 8192;
+}
+
+template<size_t SIZE>
+static uint64_t runFixed(size_t threads, size_t ops, std::vector<Recorder>& recorders) { // 固定大小，每次分配100个再全部释放
+    return runWorkers(threads, recorders, [ops](size_t, Recorder& rec){
+        void* ptrs[100];
+        for(size_t done = 0; done < ops; done += 200) {
+            for(size_t k = 0; k < 100; k++) ptrs[k] = rec.allocate(SIZE);
+            for(size_t k = 0; k < 100; k++) rec.deallocate(ptrs[k], SIZE);
+        }
+    });
+}
+
+static uint64_t runRandomMix(size_t threads, size_t ops, std::vector<Recorder>& recorders) { // 随机大小，随机顺序释放
+    return runWorkers(threads, recorders, [ops](size_t id, Recorder& rec){
+        const size_t SLOTS = 512;
+        std::vector<std::pair<void*, size_t>> live(SLOTS, std::make_pair(nullptr, 0));
+        uint64_t seed = id * 2654435761u + 1;
+        for(size_t done = 0; done < ops; done += 2) {
+            std::pair<void*, size_t>& slot = live[BenchUtil::nextRand(seed) % SLOTS];
+            if(slot.first != nullptr) rec.deallocate(slot.first, slot.second);
+            slot.second = randomSize(seed);
+            slot.first = rec.allocate(slot.second);
+        }
+        for(auto& slot : live) if(slot.first != nullptr) rec.deallocate(slot.first, slot.second);
+    });
+}
+
+static uint64_t runLarson(size_t threads, size_t ops, std::vector<Recorder>& recorders) {
+    // larson风格：每个线程随机替换一组槽位中的对象，每轮结束后各线程交换槽位，
+    // 下一轮释放的是其他线程分配的对象
+    const size_t SLOTS = 1000;
+    const size_t ROUNDS = 10;
+    std::vector<std::vector<std::pair<void*, size_t>>> sets(threads, std::vector<std::pair<void*, size_t>>(SLOTS, std::make_pair(nullptr, 0)));
+    Barrier barrier(threads);
+    uint64_t ns = runWorkers(threads, recorders, [&](size_t id, Recorder& rec){
+        uint64_t seed = id * 40503 + 7;
+        for(size_t round = 0; round < ROUNDS; round++) {
+            std::vector<std::pair<void*, size_t>>& live = sets[(id + round) % threads];
+            for(size_t done = 0; done < ops / ROUNDS; done += 2) {
+                std::pair<void*, size_t>& slot = live[BenchUtil::nextRand(seed) % SLOTS];
+                if(slot.first != nullptr) rec.deallocate(slot.first, slot.second);
+                slot.second = (BenchUtil::nextRand(seed) % 8 + 1) * 16;
+                slot.first = rec.allocate(slot.second);
+            }
+            barrier.wait();
+        }
+        for(auto& slot : sets[(id + ROUNDS) % threads]) { // 最后一轮之后各线程持有的槽位仍互不相同
+            if(slot.first != nullptr) rec.deallocate(slot.first, slot.second);
+        }
+    });
+    return ns;
+}
+
+static uint64_t runProducerConsumer(size_t threads, size_t ops, std::vector<Recorder>& recorders) {
+    // 生产者分配、消费者释放，线程两两配对，按批交接，队列有上限以模拟流水线的背压
+    const size_t HANDOFF = 64;
+    const size_t QUEUE_LIMIT = 16;
+    const size_t OBJ_SIZE = 96;
+    struct Channel {
+        std::mutex _mutex;
+        std::condition_variable _cond;
+        std::deque<std::vector<void*>> _queue;
+        bool _done = false;
+    };
+    std::vector<Channel> channels(threads / 2);
+    return runWorkers(threads, recorders, [&](size_t id, Recorder& rec){
+        Channel& channel = channels[id / 2];
+        if(id % 2 == 0) {
+            std::vector<void*> batch;
+            for(size_t done = 0; done < ops; done++) {
+                batch.push_back(rec.allocate(OBJ_SIZE));
+                if(batch.size() == HANDOFF) {
+                    std::unique_lock<std::mutex> lock(channel._mutex);
+                    channel._cond.wait(lock, [&]{ return channel._queue.size() < QUEUE_LIMIT; });
+                    channel._queue.push_back(std::move(batch));
+                    channel._cond.notify_all();
+                    batch.clear();
+                }
+            }
+            std::lock_guard<std::mutex> lock(channel._mutex);
+            if(!batch.empty()) channel._queue.push_back(std::move(batch));
+            channel._done = true;
+            channel._cond.notify_all();
+        } else {
+            while(true) {
+                std::vector<void*> batch;
+                {
+                    std::unique_lock<std::mutex> lock(channel._mutex);
+                    channel._cond.wait(lock, [&]{ return !channel._queue.empty() || channel._done; });
+                    if(channel._queue.empty()) break;
+                    batch = std::move(channel._queue.front());
+                    channel._queue.pop_front();
+                    channel._cond.notify_all();
+                }
+                for(void* ptr : batch) rec.deallocate(ptr, OBJ_SIZE);
+            }
+        }
+    });
+}
+
+static uint64_t runLongShort(size_t threads, size_t ops, std::vector<Recorder>& recorders) {
+    // 长短生命周期混合：每32个对象中有1个保留到结束，其余在最近16次分配之后就被释放
+    return runWorkers(threads, recorders, [ops](size_t id, Recorder& rec){
+        const size_t WINDOW = 16;
+        std::vector<std::pair<void*, size_t>> longLived;
+        longLived.reserve(ops / 32 + 1);
+        std::pair<void*, size_t> window[WINDOW] = {};
+        uint64_t seed = id * 97 + 3;
+        size_t done = 0;
+        for(size_t k = 0; done < ops; k++) {
+            size_t size = randomSize(seed);
+            void* ptr = rec.allocate(size);
+            done++;
+            if(k % 32 == 0) {
+                longLived.push_back(std::make_pair(ptr, size));
+                continue;
+            }
+            std::pair<void*, size_t>& slot = window[k % WINDOW];
+            if(slot.first != nullptr) {
+                rec.deallocate(slot.first, slot.second);
+                done++;
+            }
+            slot = std::make_pair(ptr, size);
+        }
+        for(auto& slot : window) if(slot.first != nullptr) rec.deallocate(slot.first, slot.second);
+        for(auto& item : longLived) rec.deallocate(item.first, item.second);
+    });
+}
+
+static const Workload WORKLOADS[] = {
+    {"fixed-16", runFixed<16>},
+    {"fixed-64", runFixed<64>},
+    {"fixed-256", runFixed<256>},
+    {"random-mix", runRandomMix},
+    {"larson", runLarson},
+    {"prod-cons", runProducerConsumer},
+    {"long-short", runLongShort},
+};
+
+struct Result {
+    std::string _workload;
+    std::string _allocator;
+    size_t _threads;
+    uint64_t _ops;
+    uint64_t _ns;
+    double _mops;
+    uint64_t _p50, _p90, _p99, _p999, _max; // 单次操作延迟(ns)，已减去计时本身的开销
+    int64_t _dtlbMisses; // dTLB load缺失次数
+    int64_t _pageFaults;
+};
+
+static uint64_t timerOverhead() { // 连续两次读取时钟的最小间隔
+    uint64_t best = UINT64_MAX;
+    for(int i = 0; i < 1000; i++) {
+        uint64_t start = BenchUtil::nowNs();
+        uint64_t end = BenchUtil::nowNs();
+        best = std::min(best, end - start);
+    }
+    return best;
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if(sorted.empty()) return 0;
+    size_t index = (size_t)(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+static Result runOne(const Workload& workload, const Allocator& allocator, size_t threads, size_t ops, uint64_t overhead) {
+    std::vector<Recorder> recorders;
+    recorders.reserve(threads);
+    for(size_t i = 0; i < threads; i++) recorders.emplace_back(allocator, ops * 2);
+    PerfCounter dtlb(PERF_TYPE_HW_CACHE, PERF_DTLB_LOAD_MISSES);
+    PerfCounter faults(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    dtlb.start();
+    faults.start();
+    uint64_t ns = workload._run(threads, ops, recorders);
+    int64_t dtlbMisses = dtlb.stop();
+    int64_t pageFaults = faults.stop();
+    std::vector<uint64_t> samples;
+    uint64_t totalOps = 0;
+    for(auto& rec : recorders) {
+        totalOps += rec.ops();
+        for(uint64_t sample : rec.samples()) samples.push_back(sample > overhead ? sample - overhead : 0);
+    }
+    std::sort(samples.begin(), samples.end());
+    Result result;
+    result._workload = workload._name;
+    result._allocator = allocator._name;
+    result._threads = threads;
+    result._ops = totalOps;
+    result._ns = ns;
+    result._mops = ns > 0 ? (double)totalOps * 1000.0 / ns : 0;
+    result._p50 = percentile(samples, 0.5);
+    result._p90 = percentile(samples, 0.9);
+    result._p99 = percentile(samples, 0.99);
+    result._p999 = percentile(samples, 0.999);
+    result._max = samples.empty() ? 0 : samples.back();
+    result._dtlbMisses = dtlbMisses;
+    result._pageFaults = pageFaults;
+    return result;
+}
+
+static void printResult(const Result& r, const std::string& format, bool first) {
+    if(format == "csv") {
+        printf("%s,%s,%zu,%llu,%llu,%.3f,%llu,%llu,%llu,%llu,%llu,%lld,%lld\n", r._workload.c_str(), r._allocator.c_str(), r._threads,
+            (unsigned long long)r._ops, (unsigned long long)r._ns, r._mops, (unsigned long long)r._p50, (unsigned long long)r._p90,
+            (unsigned long long)r._p99, (unsigned long long)r._p999, (unsigned long long)r._max, (long long)r._dtlbMisses,
+            (long long)r._pageFaults);
+    } else if(format == "json") {
+        printf("%s{\"workload\":\"%s\",\"allocator\":\"%s\",\"threads\":%zu,\"ops\":%llu,\"ns\":%llu,\"mops\":%.3f,"
+            "\"p50_ns\":%llu,\"p90_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,\"max_ns\":%llu,\"dtlb_misses\":%lld,"
+            "\"page_faults\":%lld}\n", first ? "" : ",",
+            r._workload.c_str(), r._allocator.c_str(), r._threads, (unsigned long long)r._ops, (unsigned long long)r._ns, r._mops,
+            (unsigned long long)r._p50, (unsigned long long)r._p90, (unsigned long long)r._p99, (unsigned long long)r._p999,
+            (unsigned long long)r._max, (long long)r._dtlbMisses, (long long)r._pageFaults);
+    } else {
+        printf("%-12s %-10s %8zu %12llu %10.2f %8llu %8llu %8llu %8llu %10llu %12lld %10lld\n", r._workload.c_str(), r._allocator.c_str(),
+            r._threads, (unsigned long long)r._ops, r._mops, (unsigned long long)r._p50, (unsigned long long)r._p90,
+            (unsigned long long)r._p99, (unsigned long long)r._p999, (unsigned long long)r._max, (long long)r._dtlbMisses,
+            (long long)r._pageFaults);
+    }
+    fflush(stdout);
+}
+
+static std::vector<size_t> parseList(const char* text) {
+    std::vector<size_t> values;
+    while(*text != '\0') {
+        char* end = nullptr;
+        unsigned long value = strtoul(text, &end, 10);
+        if(end == text) break;
+        if(value > 0) values.push_back(value);
+        text = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    std::string format = "table";
+    std::string workloadFilter;
+    std::string allocatorFilter;
+    std::vector<size_t> threadCounts = {1, 2, 4, 8, 16};
+    size_t ops = 200000;
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if(strncmp(arg, "--format=", 9) == 0) format = arg + 9;
+        else if(strncmp(arg, "--workload=", 11) == 0) workloadFilter = arg + 11;
+        else if(strncmp(arg, "--allocator=", 12) == 0) allocatorFilter = arg + 12;
+        else if(strncmp(arg, "--threads=", 10) == 0) threadCounts = parseList(arg + 10);
+        else if(strncmp(arg, "--ops=", 6) == 0) ops = strtoull(arg + 6, nullptr, 10);
+        else if(strcmp(arg, "--hugepages") == 0) setHugePageMode(true); // 内存池从2MB大页区域取内存
+
+        else {
+            fprintf(stderr, "用法: %s [--format=table|csv|json] [--workload=名称] [--allocator=pool|malloc|version1] "
+                "[--threads=1,2,4] [--ops=每个线程的操作数] [--hugepages]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(format != "table" && format != "csv" && format != "json") {
+        fprintf(stderr, "未知的输出格式: %s\n", format.c_str());
+        return 1;
+    }
+    version1Init();
+    uint64_t overhead = timerOverhead();
+
+    if(format == "csv") printf("workload,allocator,threads,ops,ns,mops,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,dtlb_misses,page_faults\n");
+    else if(format == "json") printf("[\n");
+    else printf("%-12s %-10s %8s %12s %10s %8s %8s %8s %8s %10s %12s %10s\n", "workload", "allocator", "threads", "ops", "Mops/s",
+        "p50(ns)", "p90(ns)", "p99(ns)", "p999(ns)", "max(ns)", "dTLB-miss", "faults");
+    bool first = true;
+    for(const Workload& workload : WORKLOADS) {
+        if(!workloadFilter.empty() && workloadFilter != workload._name) continue;
+        for(size_t threads : threadCounts) {
+            size_t workers = threads;
+            if(workload._run == runProducerConsumer) workers = std::max<size_t>(2, threads & ~(size_t)1); // 需要成对的线程
+            for(const Allocator& allocator : ALLOCATORS) {
+                if(!allocatorFilter.empty() && allocatorFilter != allocator._name) continue;
+                runOne(workload, allocator, workers, ops / 10 + 1, overhead); // 预热：让各分配器先从系统拿到内存，结果丢弃
+                printResult(runOne(workload, allocator, workers, ops, overhead), format, first);
+                first = false;
+            }
+        }
+    }
+    if(format == "json") printf("]\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// perf_event_open计数器，统计本线程及之后创建的线程（inherit）在用户态产生的事件
+// 虚拟机或容器中硬件计数器常常不可用，此时available()为false，结果输出为-1
+#define PERF_DTLB_LOAD_MISSES (PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1; // 计入之后创建的工作线程，线程退出时计数并入本计数器
+        attr.exclude_kernel = 1; // perf_event_paranoid为2时只允许统计用户态
+        attr.exclude_hv = 1;
+        _fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    ~PerfCounter() { if(_fd >= 0) close(_fd); }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+    bool available() const { return _fd >= 0; }
+    void start() {
+        if(_fd < 0) return;
+        ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    int64_t stop() { // 返回计数，不可用时返回-1
+        if(_fd < 0) return -1;
+        ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        if(read(_fd, &value, sizeof(value)) != sizeof(value)) return -1;
+        return (int64_t)value;
+    }
+private:
+    int _fd;
+};
@@ -0,0 +1,14 @@
+#include "Version1Pool.h"
+#include "../../version1/include/MemoryPool.h"
+
+void version1Init() {
+    MyMemoryPool::BlockToHash::initMemoryBlock();
+}
+
+void* version1Allocate(size_t size) {
+    return MyMemoryPool::BlockToHash::allocateMemory(size);
+}
+
+void version1Deallocate(void* ptr, size_t size) {
+    MyMemoryPool::BlockToHash::freeMemory(ptr, size);
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+
+// version1的BlockToHash内存池
+// version1与version2的头文件使用相同的命名空间和同名的宏，不能包含在同一个编译单元中，这里只暴露三个函数
+void version1Init();
+void* version1Allocate(size_t size);
+void version1Deallocate(void* ptr, size_t size);
@@ -1,23 +1,86 @@
 #pragma once
 #include "MemoryPool.h"
 #include "../include/PageCache.h"
+#include "TransferCache.h"
+#include "Stats.h"
 
 namespace MyMemoryPool {
 
+    #define OCCUPANCY_BINS 8 // 部分分出的Span按已分出的比例划分的组数
+
+    // 一个size class的Span按占用率分组，每个Span只挂在其中一条链表上，由_mutex保护
+    // 取用时从最满的一组开始找，较空的Span没有新的分配，其中的内存块陆续释放后整个Span回到PageCache；
+    // 已经分完的Span单独放在_full中，取用时不再逐个跳过
+    struct SpanBins {
+        std::mutex _mutex;
+        SpanList _partial[OCCUPANCY_BINS]; // 还有空闲内存块的Span，下标为_useCount * OCCUPANCY_BINS / 容量，越大越满
+        SpanList _empty; // 刚从PageCache取来、还没有分出内存块的Span
+        SpanList _full; // 内存块全部分出的Span
+        SpanList& binOf(size_t useCount, size_t capacity) { // 使用计数对应的链表
+            if(useCount == 0) return _empty;
+            if(useCount >= capacity) return _full;
+            return _partial[useCount * OCCUPANCY_BINS / capacity];
+        }
+    };
+
+    // 每个NUMA节点一组SpanBins和TransferCache：线程从所在节点的链表取内存块，Span来自同一节点的PageCache；
+    // 释放时按内存块所属Span的节点归还，因此即使线程迁移到其他节点，各节点链表中的内存也始终在本节点上
     class CentralCache {
     public:
-        static CentralCache& getInstance() { // 单例模式获取CentralCache实例
-            return _instance;
+        static CentralCache& getInstance(); // 单例模式获取CentralCache实例
+        // owner为取用方ThreadCache的所有者编号，记录在Span上供跨线程释放使用，CpuCache等没有所有者的取用方传0
+        size_t FetchMemoryForThreadCache(void*& start, void*& end, size_t batchnum, size_t size, uint32_t owner = 0);
+        // 取一个还有空闲内存块的Span，依次查找最满的部分使用组、空Span，都没有时向PageCache申请，需持有bins._mutex
+        SpanList::Span* getSpanFromBins(SpanBins& bins, size_t size, size_t node);
+        // 从Span尚未切分的区域切出最多batchnum个内存块串成链表，需持有对应桶锁
+        size_t carveSpan(SpanList::Span* span, void*& start, void*& end, size_t batchnum, size_t size);
+        void FreeMemoryToSpanList(void* start, size_t size); // 将内存块释放到各自所属节点的SpanList中
+        void ReturnMemoryFromThreadCache(void* start, void* end, size_t count, size_t size); // 归还一整批内存块，优先放入TransferCache
+        void drainTransferCache(); // 将TransferCache中的所有批次拆回Span，使空闲Span可以归还给PageCache
+        void setTransferCacheEnabled(bool enabled) { _useTransferCache.store(enabled, std::memory_order_relaxed); }
+        const TransferCache& getTransferCache(size_t index, size_t node = 0) const { return _nodes[node]->_transferCache[index]; }
+        void lockAll() { // fork前按节点、下标顺序获取所有桶锁，需在PageCache::lockAll之前调用
+            for(size_t node = 0; node < _numNodes; node++){
+                for(size_t i = 0; i < FREE_LIST_SIZE; i++) _nodes[node]->_bins[i]._mutex.lock();
+            }
         }
-        size_t FetchMemoryForThreadCache(void*& start, void*& end, size_t batchnum, size_t size);
-        SpanList::Span* getSpanFromSpanList(SpanList& spanlist, size_t size); 
-        void FreeMemoryToSpanList(void* start, size_t size); // 将内存块释放到SpanList中
+        void unlockAll() {
+            for(size_t node = _numNodes; node > 0; node--){
+                for(size_t i = FREE_LIST_SIZE; i > 0; i--) _nodes[node - 1]->_bins[i - 1]._mutex.unlock();
+            }
+        }
+        void collectStats(PoolStats& stats); // 读取各size class的Span数、空闲字节数以及TransferCache中缓存的字节数
     private:
-        CentralCache() : _spanList(FREE_LIST_SIZE) {} // 私有构造函数
+        struct NodeLists { // 一个节点的全部链表
+            SpanBins _bins[FREE_LIST_SIZE]; // 每个size class一组按占用率划分的Span链表
+            TransferCache _transferCache[FREE_LIST_SIZE]; // 每个size class一个无锁的批次缓冲区
+            // 以下计数只在持有对应桶锁时修改，统计时无锁读取
+            std::atomic<size_t> _spanCount[FREE_LIST_SIZE]; // 每个size class持有的Span数
+            std::atomic<size_t> _freeObjects[FREE_LIST_SIZE]; // 每个size class的Span中空闲的内存块数
+            NodeLists() {
+                for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+                    _transferCache[i].init(SizeClass::classSize(i));
+                    _spanCount[i].store(0, std::memory_order_relaxed);
+                    _freeObjects[i].store(0, std::memory_order_relaxed);
+                }
+            }
+        };
+        CentralCache(); // 私有构造函数
         CentralCache(const CentralCache&) = delete; // 禁止拷贝构造
         CentralCache& operator=(const CentralCache&) = delete; // 禁止赋值操作
-        static CentralCache _instance; // 单例
-        std::vector<SpanList> _spanList; // 每个元素对应一个SpanList
+        size_t nodeOf(void* ptr) { // 内存块所属Span的节点，单节点时不查页表
+            return _numNodes == 1 ? 0 : PageCache::getIdOfSpan(ptr)->_node;
+        }
+        NodeLists _localNode; // 节点0的链表内嵌在单例中，其他节点的在构造时用systemAlloc创建，单节点机器上没有额外开销
+        NodeLists* _nodes[MAX_NUMA_NODES];
+        size_t _numNodes = 1;
+        std::atomic<bool> _useTransferCache{true};
     };
 
+    inline CentralCache& CentralCache::getInstance() { // 与PageCache相同，首次使用时构造且从不析构
+        alignas(CentralCache) static char storage[sizeof(CentralCache)];
+        static CentralCache* instance = new(storage) CentralCache();
+        return *instance;
+    }
+
 } // namespace MemoryPool
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include "MemoryPool.h"
+#include <atomic>
+
+namespace MyMemoryPool {
+
+    // 按CPU划分的前端缓存，缓存的内存总量随核数而不是线程数增长，适合大量空闲线程的场景
+    // 通过glibc注册的rseq区域读取当前CPU号（只读cpu_id，不使用需要汇编的重启临界区），
+    // 不支持rseq时退化为sched_getcpu，读到CPU号之后再对该CPU的槽位加锁，线程被迁移时只会产生一次竞争而不会出错
+    // 与ThreadCache共用CentralCache，两种模式分配的内存可以互相释放
+    class CpuCache {
+    public:
+        static CpuCache& getInstance(); // 单例模式获取CpuCache实例
+        void* allocate(size_t size);
+        void deallocate(void* ptr, size_t size);
+        void releaseAll(); // 将所有CPU槽位缓存的内存归还给CentralCache
+        size_t cachedBytes(); // 所有CPU槽位当前缓存的字节数
+        static unsigned currentCpu(); // 获取当前线程所在的CPU号
+        void lockAll(); // fork前获取所有槽位锁，需在CentralCache::lockAll之前调用
+        void unlockAll();
+        void resetSampleCountdowns(); // 堆采样间隔改变时将所有槽位的倒计数清零，使新的间隔立即生效
+    private:
+        struct alignas(64) Slot { // 每个CPU一个槽位，按缓存行对齐避免伪共享
+            std::mutex _mutex;
+            void* _freeList[FREE_LIST_SIZE];
+            size_t _freeListLength[FREE_LIST_SIZE];
+            std::atomic<ptrdiff_t> _sampleCountdown; // 距离下一次堆采样还剩的字节数，与自由链表一样由槽位锁保护
+            uint64_t _sampleState; // 抽取采样间隔的随机数状态
+        };
+        CpuCache() = default;
+        CpuCache(const CpuCache&) = delete; // 禁止拷贝构造
+        CpuCache& operator=(const CpuCache&) = delete; // 禁止赋值操作
+        Slot& getSlot();
+        void initSlots();
+        void fetchFromCentralCache(Slot& slot, size_t index, size_t alignedSize);
+        void returnToCentralCache(Slot& slot, size_t index, size_t alignedSize, size_t count);
+        void countAllocation(Slot& slot, void* ptr, size_t size); // 扣减槽位的采样倒计数，减到负数时记录ptr，需持有槽位锁
+        Slot* _slots = nullptr; // 槽位数组，首次使用时按CPU数创建
+        size_t _numSlots = 0;
+        std::once_flag _initFlag;
+        std::atomic<bool> _initialized{false}; // 供releaseAll等非分配路径判断槽位是否已创建
+    };
+
+    inline CpuCache& CpuCache::getInstance() { // 与CentralCache相同，首次使用时构造且从不析构，不依赖静态对象的初始化顺序
+        alignas(CpuCache) static char storage[sizeof(CpuCache)];
+        static CpuCache* instance = new(storage) CpuCache();
+        return *instance;
+    }
+
+} // namespace MyMemoryPool
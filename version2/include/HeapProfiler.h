@@ -0,0 +1,66 @@
+#pragma once
+#include "MemoryPool.h"
+#include <atomic>
+#include <ostream>
+
+namespace MyMemoryPool {
+
+    #define HEAP_PROFILE_MAX_DEPTH 32 // 每个采样记录的最大栈深度
+    #define HEAP_PROFILE_TABLE_SIZE 4096 // 存活采样哈希表的桶数
+    #define HEAP_PROFILE_PAGE_BUCKETS 65536 // 按页号散列的计数桶数，释放时据此判断对象是否可能被采样过
+    #define HEAP_PROFILE_DISABLED_BYTES (16 * 1024 * 1024) // 关闭采样时倒计数每次重置的字节数，仅用于定期进入慢路径
+
+    // 采样堆分析器：每个ThreadCache和每个CPU槽位维护一个字节倒计数，分配时减去请求的大小，减到负数才进入慢路径，
+    // 按几何分布抽取下一次的间隔（平均每interval字节采样一次），并用backtrace记录当前调用栈
+    // 存活的采样对象放在按地址散列的表中，释放时先查按页号散列的计数桶，计数为0的对象一定没有被采样，不加锁
+    // 直接向PageCache申请的大对象（calloc、realloc增长、超过一页的对齐、批量分配的大对象）计入本线程ThreadCache的倒计数；
+    // 只有小对象的批量分配不计入
+    // 输出时按调用栈汇总：文本格式给出按采样概率放大后的估计值，pprof格式输出原始的采样值，由pprof按heap_v2的规则放大
+    class HeapProfiler {
+    public:
+        static void setSampleInterval(size_t bytes); // 平均每bytes字节采样一次，0关闭；由ThreadCache::setSampleInterval调用
+        static void initFromEnv(); // 读取环境变量MEMORYPOOL_HEAP_SAMPLE作为初始间隔，在首次创建ThreadCache时调用
+        // 首次调用backtrace会加载libgcc并分配内存，开启采样时提前调用一次，不放在分配的慢路径上；
+        // 由环境变量开启时initFromEnv还在pthread_once之内，改由createThreadCache在线程的ThreadCache就绪后调用
+        static void warmUp();
+        static size_t sampleInterval() { return _interval.load(std::memory_order_relaxed); }
+        static ptrdiff_t nextCountdown(uint64_t& state); // 抽取到下一次采样前的字节数，关闭时返回HEAP_PROFILE_DISABLED_BYTES
+        static bool charge(std::atomic<ptrdiff_t>& countdown, size_t size) { // 分配路径上扣减倒计数，减到负数时返回true
+            ptrdiff_t bytes = countdown.load(std::memory_order_relaxed) - (ptrdiff_t)size;
+            countdown.store(bytes, std::memory_order_relaxed);
+            return bytes < 0;
+        }
+        // charge返回true后由分配路径调用：重新抽取倒计数，开启采样时记录ptr的调用栈并加入存活表，内部加锁
+        // 记录期间本线程的分配（backtrace可能会分配内存）不再记录
+        static void sampleAllocation(std::atomic<ptrdiff_t>& countdown, uint64_t& state, void* ptr, size_t size);
+        static bool mayBeSampled(void* ptr) { // 释放路径上的检查，没有存活采样时只有一次读取
+            return _liveSamples.load(std::memory_order_relaxed) != 0
+                && _pageCounts[pageBucket(ptr)].load(std::memory_order_relaxed) != 0;
+        }
+        static void recordFree(void* ptr); // ptr在存活表中时将其移除，内部加锁
+        static void dump(std::ostream& os, bool pprof); // 输出存活采样的堆profile
+        static size_t liveSamples() { return _liveSamples.load(std::memory_order_relaxed); }
+        static void lockAll() { _mutex.lock(); } // fork前加锁，锁内不会再获取其他锁，顺序放在最后
+        static void unlockAll() { _mutex.unlock(); }
+    private:
+        struct Sample {
+            void* _ptr;
+            size_t _size; // 请求的字节数
+            size_t _depth;
+            void* _stack[HEAP_PROFILE_MAX_DEPTH];
+            Sample* _next; // 哈希桶中的下一个
+        };
+        static size_t pageBucket(void* ptr) { return ((uintptr_t)ptr >> PAGE_SHIFT) & (HEAP_PROFILE_PAGE_BUCKETS - 1); }
+        static size_t tableBucket(void* ptr) { return ((uintptr_t)ptr * 0x9e3779b97f4a7c15ULL) >> 52; } // 高12位，对应4096个桶
+        static bool sameStack(const Sample& a, const Sample& b);
+        static void unlinkSample(Sample** link); // 从哈希桶中摘下*link并更新计数，需持有_mutex
+        static std::atomic<size_t> _interval;
+        static std::atomic<bool> _warmedUp;
+        static std::atomic<size_t> _liveSamples;
+        static std::atomic<uint32_t> _pageCounts[HEAP_PROFILE_PAGE_BUCKETS]; // 每个桶中存活采样的个数，由_mutex保护写入
+        static std::mutex _mutex; // 保护存活表
+        static Sample* _table[HEAP_PROFILE_TABLE_SIZE];
+        static DtLenMemoryPool<Sample> _samplePool; // 采样记录不经过内存池的分配接口，记录时不会再次触发采样
+    };
+
+} // namespace MyMemoryPool
@@ -0,0 +1,32 @@
+#pragma once
+#include "MemoryPool.h"
+#include "NumaTopology.h"
+
+namespace MyMemoryPool {
+
+    #define HUGE_PAGE_SIZE (2 * 1024 * 1024) // x86-64/aarch64上透明大页和默认hugetlb页的大小
+    #define HUGE_PAGE_PAGES (HUGE_PAGE_SIZE / PAGE_SIZE)
+    #define ARENA_BYTES (64 * 1024 * 1024) // 每次向系统预留的区域大小，只占虚拟地址空间，访问时才分配物理页
+
+    // 大页区域：按2MB对齐预留大块地址空间，PageCache需要新内存时从中按页顺序切出，
+    // 相邻切出的Span在地址上连续，可以合并成覆盖整个大页的Span，减少TLB缺失
+    // 优先使用MAP_HUGETLB（需要系统预留hugetlb页），失败时退化为普通映射加madvise(MADV_HUGEPAGE)
+    // 不加锁，由PageCache的_mutexPage保护
+    class HugePageArena {
+    public:
+        explicit HugePageArena(size_t node = 0) : _node(node) {}
+        // 切出numPages页；当前区域剩余部分不够时预留新的区域，旧区域剩余的页通过restStart/restPages交给调用者回收
+        void* allocate(size_t numPages, void*& restStart, size_t& restPages);
+        bool usingHugeTlb() const { return _hugeTlb; } // 最近一次预留是否使用了MAP_HUGETLB
+        // 将[start, start + numPages页)中完整覆盖的2MB大页归还给操作系统，不拆分大页，返回归还的页数
+        static size_t releaseHugePages(void* start, size_t numPages);
+        static size_t hugePagesIn(void* start, size_t numPages); // 区间内完整覆盖的大页对应的页数
+    private:
+        bool reserve(size_t bytes); // 预留一块2MB对齐的新区域
+        char* _cursor = nullptr; // 当前区域中尚未切出部分的起始地址
+        char* _end = nullptr;
+        bool _hugeTlb = false;
+        size_t _node; // 所属PageCache的NUMA节点，新预留的区域在访问前绑定到该节点
+    };
+
+} // namespace MyMemoryPool
@@ -7,7 +7,8 @@
 #include <sys/mman.h>
 #include <cstring>
 #include <cassert>
-#include <unordered_map>
+#include <chrono>
+#include <atomic>
 
 namespace MyMemoryPool {
 
@@ -19,114 +20,60 @@ namespace MyMemoryPool {
         typedef size_t PAGE_ID;
     #endif
 
-    #define FREE_LIST_SIZE 216 // 自由链表数组的长度
     #define MAX_BYTES (512 * 1024) // 最大字节数为512KB
-    #define MAX_FREELIST_NUMBERS 256 // 每个自由链表的最大节点数
+    #define MAX_FREELIST_NUMBERS 256 // 与CentralCache之间一次批量传输的最大节点数
+    #define MAX_DYNAMIC_FREELIST_LENGTH 8192 // ThreadCache单个自由链表慢开始增长的上限，实际长度还受线程缓存字节数限制
+    #define THREAD_CACHE_BUDGET (64 * 1024 * 1024) // 所有ThreadCache缓存字节数之和的默认上限
+    #define MIN_THREAD_CACHE_SIZE (2 * MAX_BYTES) // 单个ThreadCache的最小容量，被其他线程窃取时不会低于此值
+    #define MAX_THREAD_CACHE_SIZE (16 * 1024 * 1024) // 单个ThreadCache的最大容量
+    #define MAX_REMOTE_FREE_OWNERS 4096 // 跨线程释放队列的所有者编号上限，超出后新线程不再接收其他线程的释放
+    #define THREAD_CACHE_STEAL_SIZE (64 * 1024) // 每次从其他线程窃取的容量
     #define PAGE_SIZE 4096 // 定义页面大小为4KB
-    #define MAX_PAGES 128 // 每个Span最多包含128页
+    #define MAX_PAGES 128 // 按页数分桶管理的Span最多包含128页，更大的Span单独挂在一条链表上
     #define PAGE_SHIFT 12 // 页面大小的位移量，4096 = 2^12
-    const std::vector<size_t> Hash_Buckets = {16, 56, 56, 56, 24, 8}; // 总和为FREE_LIST_SIZE
+
+} // namespace MyMemoryPool
+
+#include "SizeClassPolicy.h" // 依赖上面的常量
+
+namespace MyMemoryPool {
 
     // 将指针强转成void**类型，再进行解引用,即可访问void*大小的地址，在64位系统中即为对该内存块头8字节的访问
-    static void*& ptrNext(void* ptr) { // 获取下一个指针
+    static inline void*& ptrNext(void* ptr) { // 获取下一个指针
         return *reinterpret_cast<void**>(ptr);
     }
     
-    static inline void* systemAlloc(size_t numPages){ // 直接与操作系统交互通过mmap申请大块内存
+    static inline void systemRelease(void* ptr, size_t numPages){ // 将页归还给操作系统但保留映射，再次访问时按需缺页并得到清零的页
+        madvise(ptr, numPages * PAGE_SIZE, MADV_DONTNEED);
+    }
+
+    static inline uint64_t monotonicNs(){ // 单调时钟，单位纳秒
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    extern std::atomic<size_t> systemMappedBytes; // 通过systemAlloc向操作系统申请的总字节数，只增不减
+
+    // 直接与操作系统交互通过mmap申请大块内存；匿名映射的页由内核在首次访问时清零并分配物理页，
+    // 这里不能memset，否则整块区域会立刻全部常驻
+    static inline void* systemAlloc(size_t numPages){
         size_t size = numPages * PAGE_SIZE;
         void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
         if(ptr == MAP_FAILED){
             std::cerr << "Error: Memory allocation failed." << std::endl;
             return nullptr;
         }
-        memset(ptr, 0, size); // 清零内存
+        systemMappedBytes.fetch_add(size, std::memory_order_relaxed);
         return ptr; // 返回分配的内存地址
     }
     
-    class SizeClass { // SizeClass类用于处理内存大小分类
-    public:
-        // 平衡哈希桶的数量和内碎片的大小，将内碎片的浪费控制在11%左右
-        static inline size_t getIndex(size_t size) { // 根据自定规则建立哈希映射--->>>映射到哪一个哈希桶,返回索引
-            assert(size > 0 && size <= MAX_BYTES); 
-            if(size <= 128){ // 小于等于128字节，按照8字节对齐
-                return _getIndex(size, 3);
-            }else if(size <= 1024){ // 小于等于1024字节，按照16字节对齐
-                return _getIndex(size - 128, 4) + Hash_Buckets[0];
-            }else if(size <= 8 * 1024){ // 小于等于8KB，按照128字节对齐
-                return _getIndex(size - 1024, 7) + Hash_Buckets[0] + Hash_Buckets[1];
-            }else if(size <= 64 * 1024){ // 小于等于64KB，按照1024字节对齐
-                return _getIndex(size - 8 * 1024, 10) + Hash_Buckets[0] + Hash_Buckets[1] + Hash_Buckets[2];
-            }else if(size <= 256 * 1024){ // 小于等于256KB，按照8KB对齐
-                return _getIndex(size - 64 * 1024, 13) + Hash_Buckets[0] + Hash_Buckets[1] + Hash_Buckets[2] + Hash_Buckets[3];
-            }else if(size <= 512 * 1024){  //小于等于512KB，按照32KB对齐
-                return _getIndex(size - 256 * 1024, 15) + Hash_Buckets[0] + Hash_Buckets[1] + Hash_Buckets[2] + Hash_Buckets[3] + Hash_Buckets[4];
-            }else{
-                std::cerr << "Error: Size exceeds maximum limit." << std::endl;
-            }
-            return -1;
-        }
-        static inline size_t alignMemory(size_t size){ // 建立内存对齐规则--->>>返回内存对齐后的size
-            assert(size > 0 && size <= MAX_BYTES);
-            if(size <= 128)
-                return _alignMemory(size, 8);
-            else if(size <= 1024)
-                return _alignMemory(size, 16);
-            else if(size <= 8 * 1024)
-                return _alignMemory(size, 128);
-            else if(size <= 64 * 1024)
-                return _alignMemory(size, 1024);
-            else if(size <= 256 * 1024)
-                return _alignMemory(size, 8192);
-            else if(size <= 512 * 1024)
-                return _alignMemory(size, 32768);
-            else
-                std::cerr << "Error: Size exceeds maximum limit." << std::endl;
-            return -1;
-        }
-        static size_t normBatchNum(size_t size) { // 规范化批量分配的数量
-            assert(size > 0 && size <= MAX_BYTES);
-            size_t num = MAX_BYTES / size; // 每个批次的数量
-            if(num < 2) {
-                num = 2; // 最小批次数量为2
-            } else if(num > MAX_FREELIST_NUMBERS) {
-                num = MAX_FREELIST_NUMBERS; // 最大批次数量为MAX_FREELIST_NUMBERS
-            }
-            return num;
-        }
-        static size_t normPageNum(size_t size){
-            assert(size > 0 && size <= MAX_BYTES);
-            size_t num = normBatchNum(size);
-            size_t sizePages = num * size;
-            size_t pageNum = (sizePages + PAGE_SIZE - 1) / PAGE_SIZE; // 向上取整计算页数
-            if(pageNum < 1) {
-                pageNum = 1; // 最小页数为1
-            }
-            if(pageNum > MAX_PAGES){
-                pageNum = MAX_PAGES; // 最大页数为MAX_PAGES
-            }
-            return pageNum;
-        }
-    private:
-        static inline size_t _getIndex(size_t size, size_t alignsize){ // 获取内存大小对应的索引
-            return ((size + (1 << alignsize) - 1) >> alignsize) - 1; // 采用位运算提高效率
-            // 等效于
-            // if(size % alignsize == 0) {
-            //     return size / alignsize - 1;
-            // } else {
-            //     return size / alignsize;
-            // }
-            // 如果采用位运算，这里的alignsize是对齐大小，通常是2的幂次方；否则是字节大小
-        }
-        static inline size_t _alignMemory(size_t size, size_t alignsize){ // 内存对齐,返回对齐后的内存大小
-            return (size + alignsize - 1) & ~(alignsize - 1); // 采用位运算提高效率
-            // 等效于
-            // if(size % alignsize == 0) {
-            //    return size;
-            // } else {
-            //    return (size / alignsize + 1) * alignsize;
-            // }
-        }
-    };
+    // size class的表格在编译期由策略生成，定义MEMORYPOOL_FINE_SIZE_CLASSES时使用更细的划分
+    #ifdef MEMORYPOOL_FINE_SIZE_CLASSES
+        typedef SizeClassMap<FineSizeClassPolicy> SizeClass;
+    #else
+        typedef SizeClassMap<DefaultSizeClassPolicy> SizeClass;
+    #endif
+    #define FREE_LIST_SIZE (SizeClass::NUM_CLASSES) // 自由链表数组的长度，即size class的个数
 
     class SpanList{ // 维护一个双向循环链表类，用于中心缓存构建Span
     public:
@@ -138,9 +85,22 @@ namespace MyMemoryPool {
             Span* _prev = nullptr; // 指向上一个Span的指针
             size_t _useCount = 0; // 分配给ThreadCache的使用计数
             void* _freeList = nullptr; // 每个Span下挂载的自由链表
+            void* _unusedStart = nullptr; // 尚未切分的区域起点，CentralCache按批次从这里懒切分，没有切到的页不会被访问
             bool _isUse = false; // 是否正在使用
+            size_t _objSize = 0; // 切分出的对象大小（即所属size class对齐后的大小），用于无尺寸释放；为0表示整个Span是一个大对象
+            size_t _releasedPages = 0; // 空闲期间已通过madvise归还给操作系统的页数，常驻页数为_numPages - _releasedPages
+            uint64_t _freeTime = 0; // 进入PageCache空闲链表的时间(ns)，后台回收据此判断空闲时长
+            bool _isZero = false; // 所有页都确定为零：刚从系统申请且没有交出去过，或已整体madvise归还
+            // 所属NUMA节点的下标，由所属节点的PageCache设置。其他节点合并相邻Span时不加这个节点的锁读取它，
+            // 读到的只会是所属节点或这里的默认值，二者都不等于读取者自己的节点，因此不会误合并
+            uint8_t _node = 0xFF;
+            // 最近一次从该Span取走内存块的ThreadCache的所有者编号，0表示没有；开启跨线程释放时，其他线程释放的内存块交还给它
+            // 在CentralCache的桶锁下写入，释放时不加锁读取，读到旧值也只是把内存块交给了另一个线程
+            std::atomic<uint32_t> _owner{0};
         };
-        SpanList() : _head() {_head = new Span(); _head->_next = _head; _head->_prev = _head; } // 初始化头结点
+        SpanList() : _head(&_headNode) { _head->_next = _head; _head->_prev = _head; } // 初始化头结点，头结点内嵌在链表对象中，不需要堆分配
+        SpanList(const SpanList&) = delete; // 头结点指向自身，禁止拷贝
+        SpanList& operator=(const SpanList&) = delete;
         void push(Span* ptr, Span* index){ // 将一个元素插入到链表index之前（不用考虑越界问题）
             if (ptr == nullptr || index == nullptr) return;
             Span* temp = index->_prev;
@@ -188,49 +148,153 @@ namespace MyMemoryPool {
         //     delete _head; // 释放头结点内存
         // }
     private:
+        Span _headNode;
         Span* _head;
     };
 
+    // DtLenMemoryPool每次向系统申请的内存块大小，可以按类型特化；默认64KB且至少容纳8个对象，按页取整
+    template<typename T>
+    struct DtLenPoolTraits {
+        static constexpr size_t CHUNK_BYTES = ((sizeof(T) * 8 > 64 * 1024 ? sizeof(T) * 8 : 64 * 1024) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+    };
+
+    template<>
+    struct DtLenPoolTraits<SpanList::Span> { // Span数量多且生命周期短，用大块减少映射区域的数量
+        static constexpr size_t CHUNK_BYTES = 512 * 1024;
+    };
+
+    // 定长对象池，用于代替本项目中的new/delete操作，也可以用于其他频繁创建销毁的对象
+    // 空闲对象组成无锁栈（Treiber栈）：New/Delete各一次CAS，不加锁；只有空闲对象用完、需要从内存块切分时才加锁
+    // 栈顶是带标记的指针：低48位为地址，高16位在每次修改时加一，即使同一个对象被弹出又压回，CAS也会因为标记不同而失败（ABA）
+    // 内存块从不归还给操作系统，弹出时读到已被其他线程取走的对象的链接也不会访问非法内存，由CAS的失败重试
+    // （ThreadSanitizer会把这次读取报告为与该对象构造的数据竞争，读到的值随CAS失败被丢弃）
+    // 对象池本身可以常量初始化，替换malloc时在任何动态初始化之前就能使用
     template<typename T>
-    class DtLenMemoryPool { // 定长内存池类，用于代替本项目中的new/delete操作
+    class DtLenMemoryPool {
     public:
-        T* New(){
-            std::lock_guard<std::mutex> lock(_mutex); // 确保线程安全
-            T* ptr = nullptr;
-            if(_freeList != nullptr){
-                void* next = ptrNext(_freeList);
-                ptr = static_cast<T*>(_freeList);
-                _freeList = next; // 更新自由链表头指针
-            }else{
-                if(_remainSize < sizeof(T)){ // 剩余空间不足，重新申请
-                    _remainSize = 512 * 1024; // 每次申请512KB,实现定长512KB
-                    _memory = static_cast<char*>(systemAlloc(_remainSize >> PAGE_SHIFT)); // 申请内存
-                    if(_memory == nullptr) {
-                        std::cerr << "Error: Memory allocation failed." << std::endl;
-                        return nullptr;
-                    }
-                }
-                ptr = reinterpret_cast<T*>(_memory);
-                size_t ptrSize = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T); // 确保指针大小不小于T的大小
-                _memory += ptrSize;
-                _remainSize -= ptrSize; // 更新剩余空间
-            }
-            new(ptr)T;
-            return ptr;
+        template<typename... Args>
+        T* New(Args&&... args) { // 构造参数原样转发给T的构造函数
+            void* ptr = nullptr;
+            if(popFree(ptr, 1) == 0 && carve(ptr, 1) == 0) return nullptr;
+            return new(ptr) T(std::forward<Args>(args)...);
         }
 
-        void Delete(T* ptr){
+        void Delete(T* ptr) {
             if(ptr == nullptr) return;
-            std::lock_guard<std::mutex> lock(_mutex); // 确保线程安全
             ptr->~T(); // 调用析构函数
-            ptrNext(ptr) = _freeList; // 将释放的内存块插入回自由链表头
-            _freeList = ptr;
+            pushFree(ptr, ptr);
         }
+
+        // 批量创建n个对象写入ptrs，空闲对象一次CAS整段取出，不足的部分一次加锁切分；返回创建的个数，只有内存不足时才会少于n
+        // 与New不同，args不转发：n个对象都以同一组args作为左值构造，右值参数不会被移走，只接受右值的构造函数无法使用
+        template<typename... Args>
+        size_t NewN(T** ptrs, size_t n, Args&&... args) {
+            if(n == 0) return 0;
+            void* head = nullptr;
+            size_t count = popFree(head, n);
+            if(count < n) {
+                void* carved = nullptr;
+                size_t more = carve(carved, n - count);
+                if(more > 0) { // 切出的链表接在空闲链表后面
+                    void* tail = carved;
+                    while(link(tail).load(std::memory_order_relaxed) != nullptr) tail = link(tail).load(std::memory_order_relaxed);
+                    link(tail).store(head, std::memory_order_relaxed);
+                    head = carved;
+                    count += more;
+                }
+            }
+            for(size_t i = 0; i < count; i++) {
+                void* next = link(head).load(std::memory_order_relaxed);
+                ptrs[i] = new(head) T(args...); // 每次都以左值传入，前面的对象不会把参数移走
+                head = next;
+            }
+            return count;
+        }
+
+        void DeleteN(T** ptrs, size_t n) { // 析构后串成一条链表，一次CAS全部放回
+            if(n == 0) return;
+            for(size_t i = 0; i < n; i++) {
+                ptrs[i]->~T();
+                link(ptrs[i]).store(i + 1 < n ? static_cast<void*>(ptrs[i + 1]) : nullptr, std::memory_order_relaxed);
+            }
+            pushFree(ptrs[0], ptrs[n - 1]);
+        }
+
+        void lock() { _mutex.lock(); } // 供fork前后使用，保证子进程继承的内存块状态一致；空闲栈的每次修改都是单个CAS，本身总是一致的
+        void unlock() { _mutex.unlock(); }
     private:
-        char* _memory = nullptr; // 内存池的起始地址
-        size_t _remainSize = 0; // 剩余空间大小
-        void* _freeList = nullptr; // 自由链表头指针
-        std::mutex _mutex; // 互斥锁，确保线程安全
+        static constexpr size_t SLOT_SIZE = sizeof(T) < sizeof(void*) ? sizeof(void*) : sizeof(T); // 空闲时头8字节存放链接
+        static constexpr size_t CHUNK_BYTES = DtLenPoolTraits<T>::CHUNK_BYTES;
+        static constexpr int TAG_SHIFT = 48;
+        static constexpr uint64_t POINTER_MASK = (1ULL << TAG_SHIFT) - 1;
+        static_assert(CHUNK_BYTES % PAGE_SIZE == 0 && CHUNK_BYTES >= SLOT_SIZE, "chunk must be whole pages holding at least one object");
+
+        static std::atomic<void*>& link(void* ptr) { // 空闲对象的链接；弹出时可能与其他线程并发读写，因此按原子变量访问
+            return *reinterpret_cast<std::atomic<void*>*>(ptr);
+        }
+        static void* untag(uint64_t top) { return reinterpret_cast<void*>(top & POINTER_MASK); }
+        static uint64_t retag(void* ptr, uint64_t oldTop) {
+            return reinterpret_cast<uint64_t>(ptr) | ((oldTop & ~POINTER_MASK) + (1ULL << TAG_SHIFT));
+        }
+
+        void pushFree(void* head, void* tail) { // 将head到tail的链表压入空闲栈
+            uint64_t top = _freeList.load(std::memory_order_relaxed);
+            do {
+                link(tail).store(untag(top), std::memory_order_relaxed);
+            } while(!_freeList.compare_exchange_weak(top, retag(head, top), std::memory_order_release, std::memory_order_relaxed));
+        }
+
+        size_t popFree(void*& head, size_t n) { // 从空闲栈取出最多n个对象组成以nullptr结尾的链表
+            uint64_t top = _freeList.load(std::memory_order_acquire);
+            for(;;) {
+                void* first = untag(top);
+                if(first == nullptr) return 0;
+                // 每跟随一个链接之前确认栈没有变化，保证读到链接时该对象仍在栈中，链接有效
+                void* last = first;
+                void* rest = link(last).load(std::memory_order_relaxed);
+                size_t count = 1;
+                while(count < n && rest != nullptr && _freeList.load(std::memory_order_acquire) == top) {
+                    last = rest;
+                    rest = link(last).load(std::memory_order_relaxed);
+                    count++;
+                }
+                if(count < n && rest != nullptr) { // 栈在遍历期间被修改，重新开始
+                    top = _freeList.load(std::memory_order_acquire);
+                    continue;
+                }
+                if(_freeList.compare_exchange_weak(top, retag(rest, top), std::memory_order_acquire, std::memory_order_acquire)) {
+                    link(last).store(nullptr, std::memory_order_relaxed);
+                    head = first;
+                    return count;
+                }
+            }
+        }
+
+        size_t carve(void*& head, size_t n) { // 从当前内存块切出最多n个对象组成链表，内存块用完时向系统申请CHUNK_BYTES
+            std::lock_guard<std::mutex> lock(_mutex);
+            head = nullptr;
+            size_t count = 0;
+            for(; count < n; count++) {
+                if(_remainSize < SLOT_SIZE) { // 剩余空间不足，重新申请
+                    _memory = static_cast<char*>(systemAlloc(CHUNK_BYTES >> PAGE_SHIFT));
+                    if(_memory == nullptr) {
+                        _remainSize = 0;
+                        break;
+                    }
+                    _remainSize = CHUNK_BYTES;
+                }
+                link(_memory).store(head, std::memory_order_relaxed);
+                head = _memory;
+                _memory += SLOT_SIZE;
+                _remainSize -= SLOT_SIZE; // 更新剩余空间
+            }
+            return count;
+        }
+
+        std::atomic<uint64_t> _freeList{0}; // 空闲对象栈的栈顶，带标记的指针
+        std::mutex _mutex; // 保护下面两项，只在切分新对象时使用
+        char* _memory = nullptr; // 当前内存块中尚未切分的起始地址
+        size_t _remainSize = 0; // 当前内存块剩余的字节数
     };
 
 } // namespace MyMemoryPool
\ No newline at end of file
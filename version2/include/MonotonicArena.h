@@ -0,0 +1,76 @@
+#pragma once
+#include "PageCache.h"
+#include <type_traits>
+#include <utility>
+
+namespace MyMemoryPool {
+
+    #define MONOTONIC_ARENA_MIN_PAGES 8 // 第一个Span的页数(32KB)，之后每次翻倍，直到MAX_PAGES
+
+    // 单调区域分配器：在从PageCache取得的整页Span中按指针递增分配，单个对象不能释放，
+    // 请求结束时reset()/析构一次性归还所有Span，不经过ThreadCache，也不逐个写回自由链表
+    // mark()/rewind()以及Scope支持嵌套作用域：回退到标记处，释放标记之后的分配并归还之后取得的Span
+    // Span按大对象标记（_objSize为0），统计中计入大对象；Span通过_next串成栈，栈顶为最新的Span
+    // 不加锁，一个实例只能由一个线程使用；Span可以在任意线程归还
+    class MonotonicArena {
+    public:
+        struct Mark { // 分配位置的快照，只在取得它之后没有reset()/release()时有效
+            SpanList::Span* _top;
+            SpanList::Span* _current;
+            char* _ptr;
+        };
+
+        class Scope { // 嵌套作用域：构造时记录位置，析构时回退
+        public:
+            explicit Scope(MonotonicArena& arena) : _arena(arena), _mark(arena.mark()) {}
+            ~Scope() { _arena.rewind(_mark); }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        private:
+            MonotonicArena& _arena;
+            Mark _mark;
+        };
+
+        MonotonicArena() = default;
+        ~MonotonicArena() { release(); }
+        MonotonicArena(const MonotonicArena&) = delete; // 禁止拷贝构造
+        MonotonicArena& operator=(const MonotonicArena&) = delete; // 禁止赋值操作
+
+        // alignment为2的幂且不超过一页；size为0时按1字节分配；无法取得新Span时返回nullptr
+        void* allocate(size_t size, size_t alignment = 8) {
+            assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && alignment <= PAGE_SIZE);
+            char* ptr = (char*)(((uintptr_t)_ptr + alignment - 1) & ~(uintptr_t)(alignment - 1));
+            if(size != 0 && ptr <= _end && size <= (size_t)(_end - ptr)){
+                _ptr = ptr + size;
+                return ptr;
+            }
+            return allocateSlow(size == 0 ? 1 : size, alignment);
+        }
+
+        template<typename T, typename... Args>
+        T* New(Args&&... args) { // 析构函数不会被调用，只允许平凡析构的类型
+            static_assert(std::is_trivially_destructible<T>::value, "MonotonicArena never runs destructors");
+            void* ptr = allocate(sizeof(T), alignof(T));
+            if(ptr == nullptr) return nullptr;
+            return new(ptr) T(std::forward<Args>(args)...);
+        }
+
+        Mark mark() const { return Mark{_spans, _current, _ptr}; }
+        void rewind(const Mark& mark); // 回退到mark，之后取得的Span一次归还
+        void reset(); // 保留当前（最大的）Span从头复用，其余Span一次归还，之前的Mark全部失效
+        void release(); // 归还所有Span
+        size_t spanBytes() const { return _spanBytes; } // 当前持有的Span的总字节数
+    private:
+        void* allocateSlow(size_t size, size_t alignment);
+        void freeSpansAbove(SpanList::Span* top); // 将栈中top之上的Span摘下并归还
+        static char* spanStart(SpanList::Span* span) { return (char*)(span->_pageID << PAGE_SHIFT); }
+        static char* spanEnd(SpanList::Span* span) { return (char*)((span->_pageID + span->_numPages) << PAGE_SHIFT); }
+        SpanList::Span* _spans = nullptr; // 持有的所有Span，包括单独分配的大块
+        SpanList::Span* _current = nullptr; // 正在切分的Span
+        char* _ptr = nullptr; // _current中下一次分配的起点
+        char* _end = nullptr;
+        size_t _nextPages = MONOTONIC_ARENA_MIN_PAGES; // 下一个切分用的Span的页数
+        size_t _spanBytes = 0;
+    };
+
+} // namespace MyMemoryPool
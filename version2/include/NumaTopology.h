@@ -0,0 +1,41 @@
+#pragma once
+#include "MemoryPool.h"
+
+namespace MyMemoryPool {
+
+    #define MAX_NUMA_NODES 8 // 按节点划分PageCache和CentralCache的最大节点数，更多的节点按下标取模合并
+    #define MAX_NUMA_CPUS 1024 // CPU号 -> 节点映射表的大小，超出的CPU归到节点0
+
+    // NUMA拓扑：从/sys/devices/system/node读取在线节点以及每个节点的CPU列表
+    // 只用open/read系统调用和栈上缓冲区解析，不分配内存，替换malloc时也可以在首次分配期间构造
+    // 读取失败（没有挂载sysfs、内核不支持NUMA）时视为单节点，此时所有接口都退化为不区分节点的行为
+    // 环境变量MEMORYPOOL_NUMA_NODES=n可以在节点数不足n的机器上模拟n个节点（CPU按编号轮流归属，不调用mbind），用于测试
+    class NumaTopology {
+    public:
+        static NumaTopology& getInstance();
+        size_t nodeCount() const { return _numNodes; }
+        size_t currentNode() const; // 当前线程所属节点的下标(0 ~ nodeCount()-1)，优先使用setThreadNode设置的节点
+        size_t nodeOfCpu(unsigned cpu) const { return cpu < MAX_NUMA_CPUS ? _cpuToNode[cpu] : 0; }
+        int systemNodeId(size_t node) const { return _nodeIds[node]; } // 节点下标 -> 系统中的节点号，节点号可能不连续
+        static void setThreadNode(int node); // 将当前线程固定到某个节点（绑核的线程可以省去按CPU查询），-1恢复按CPU判断
+        // 将[ptr, ptr + bytes)的内存策略设为优先从node分配物理页（MPOL_PREFERRED，该节点内存不足时由内核退到其他节点）
+        // 需在首次访问之前调用；单节点或模拟的节点上什么也不做，返回false
+        bool bindToNode(void* ptr, size_t bytes, size_t node) const;
+    private:
+        NumaTopology();
+        NumaTopology(const NumaTopology&) = delete; // 禁止拷贝构造
+        NumaTopology& operator=(const NumaTopology&) = delete; // 禁止赋值操作
+        bool readTopology();
+        size_t _numNodes = 1;
+        bool _simulated = false; // 节点是否由MEMORYPOOL_NUMA_NODES模拟
+        int _nodeIds[MAX_NUMA_NODES] = {0};
+        uint8_t _cpuToNode[MAX_NUMA_CPUS] = {0};
+    };
+
+    inline NumaTopology& NumaTopology::getInstance() { // 与PageCache相同，首次使用时在静态存储上构造且从不析构
+        alignas(NumaTopology) static char storage[sizeof(NumaTopology)];
+        static NumaTopology* instance = new(storage) NumaTopology();
+        return *instance;
+    }
+
+} // namespace MyMemoryPool
@@ -1,25 +1,124 @@
 #pragma once
 #include "MemoryPool.h"
+#include "PageMap.h"
+#include "Stats.h"
+#include "HugePageArena.h"
+#include "NumaTopology.h"
+#include <condition_variable>
+#include <cstdlib>
 
 namespace MyMemoryPool {
+    // 每个NUMA节点一个PageCache，管理从该节点申请（并用mbind绑定到该节点）的页；所有节点共用一个页表
+    // 分配优先使用当前线程所在节点；本节点既没有空闲Span、也无法再向系统申请时，从其他节点的空闲Span中借用，
+    // 借来的Span改为属于本节点，释放后回到本节点。单节点机器上只有一个实例，行为与不区分节点时相同
     class PageCache {
     public:
-        std::mutex _mutexPage; // 互斥锁
-        static PageCache& getInstance() { // 单例模式获取PageCache实例
-            return _instance;
-        }
-        SpanList::Span* AllocNewSpanToCentralCache(size_t numPages);
-        SpanList::Span* getIdOfSpan(void* ptr);
-        void FreeSpanToPageCache(SpanList::Span* span);
+        std::mutex _mutexPage; // 互斥锁，保护本节点的空闲链表以及本节点Span的页表项
+        static PageCache& getInstance(); // 当前线程所在节点的PageCache
+        static PageCache& getInstance(size_t node);
+        static size_t nodeCount() { return NumaTopology::getInstance().nodeCount(); }
+        size_t node() const { return _node; }
+        // 取出numPages页的Span交给CentralCache切分，标记为使用中并记录对象大小，内部加锁
+        SpanList::Span* AllocNewSpanToCentralCache(size_t numPages, size_t objSize);
+        static SpanList::Span* getIdOfSpan(void* ptr); // 无锁查询，不需要持有_mutexPage
+        // 将Span归还到本节点并与相邻的空闲Span合并，需持有_mutexPage且span属于本节点；isZero表示归还的页从未被访问过，仍然为零
+        void FreeSpanToPageCache(SpanList::Span* span, bool isZero = false);
+        // 超过MAX_BYTES的大对象直接分配整数页的Span，内部加锁
+        // slackSize非0时尽量让对象后面紧跟至少slackSize字节的空闲页，供ResizeLargeObject原地增长，这些页仍属于PageCache
+        void* AllocLargeObject(size_t size, size_t slackSize = 0);
+        void* AllocZeroedLargeObject(size_t size); // 与AllocLargeObject相同但保证内容为零，Span确定为零时省去清零，内部加锁
+        void* AllocAlignedLargeObject(size_t size, size_t alignment); // 按alignment(2的幂，大于PAGE_SIZE)对齐的整数页Span，首尾多余的页归还，内部加锁
+        // 原地调整大对象的页数：缩小时把尾部的页归还，增大时吞并紧随其后的空闲Span，后面的页不空闲或不够时返回false
+        // 以下两个接口在大对象所属节点的PageCache上加锁执行，可以由任意节点的线程调用
+        static bool ResizeLargeObject(void* ptr, size_t newSize);
+        static void FreeLargeObject(void* ptr); // 释放大对象，Span归还后与相邻空闲Span合并
+        // 一次归还由_next串起的多个大对象Span（MonotonicArena整体释放时使用），同一节点的连续Span只加一次锁
+        static void FreeLargeSpans(SpanList::Span* head);
+        size_t releaseIdleSpans(uint64_t idleNs); // 将本节点空闲超过idleNs的Span归还给操作系统，返回本次释放的页数，内部加锁
+        static size_t releaseFreeMemory(); // 立即归还所有节点的空闲Span
+        static void startScavenger(uint64_t idleMs, uint64_t intervalMs); // 启动后台回收线程，每intervalMs检查一次所有节点
+        static void stopScavenger();
+        static void lockAll(); // fork前按节点顺序获取所有锁，fork后在父子进程中分别释放，避免子进程继承到被其他线程持有的锁
+        static void unlockAll();
+        static void collectStats(PoolStats& stats); // 遍历各节点的空闲链表统计各页数的Span，内部加锁
+        // 开启后新内存从2MB对齐的大页区域中切出，回收时只归还完整的大页；只影响之后向系统申请的内存，作用于所有节点
+        // 也可以通过环境变量MEMORYPOOL_HUGEPAGES=1在首次使用前开启
+        static void setHugePageMode(bool enabled);
+        static bool hugePageMode();
     private:
-        PageCache() : _spanList(MAX_PAGES) {} // 私有构造函数
+        // 从本节点取出numPages页的Span并标记为使用中，本节点无法分配时向其他节点借用，内部加锁
+        SpanList::Span* allocInUseSpan(size_t numPages, size_t slackPages, size_t objSize);
+        // 依次向其他节点借用空闲Span，同时持有两个节点的锁（按下标顺序加锁），调用时不能持有任何节点的锁
+        SpanList::Span* allocFromOtherNodes(size_t numPages, size_t objSize);
+        void markInUse(SpanList::Span* span, size_t objSize); // 标记为使用中并更新大对象的统计，需持有_mutexPage
+        SpanList::Span* allocSystemSpan(size_t numPages); // 向系统申请至少numPages页并绑定到本节点，构造成Span返回
+        // 取出numPages页的Span，slackPages见AllocLargeObject，allowSystem为false时只使用已有的空闲Span，需持有_mutexPage
+        SpanList::Span* allocSpan(size_t numPages, size_t slackPages, bool allowSystem);
+        SpanList::Span* findFreeSpan(size_t numPages); // 查找页数不小于numPages的最小空闲Span
+        SpanList::Span* newSpan(); // 从定长内存池中分配一个属于本节点的Span
+        void ensurePages(PAGE_ID start, size_t numPages); // 建好新内存对应的页表节点
+        void pushFreeSpan(SpanList::Span* span); // 按页数将空闲Span挂到对应链表
+        void removeFreeSpan(SpanList::Span* span); // 将空闲Span从所在链表上摘下
+        bool resizeLargeObject(SpanList::Span* span, size_t newSize);
+        size_t releaseSpanList(SpanList& list, uint64_t now, uint64_t idleNs);
+        void collectNodeStats(PoolStats& stats);
+        void scavengeLoop(uint64_t idleNs, uint64_t intervalNs);
+        static SpanPageMap& pageMap(); // 所有节点共用的页表
+        static std::mutex& pageMapMutex(); // 保护页表中间节点和叶子节点的创建
+        explicit PageCache(size_t node) : _node(node), _arena(node) { // 私有构造函数
+            const char* env = getenv("MEMORYPOOL_HUGEPAGES"); // getenv不分配内存，替换malloc时也可以在这里调用
+            _hugePages = env != nullptr && env[0] == '1';
+        }
         PageCache(const PageCache&) = delete; // 禁止拷贝构造
         PageCache& operator=(const PageCache&) = delete; // 禁止赋值操作
-        static PageCache _instance; // 单例
-        std::vector<SpanList> _spanList; // Span链表,对应页数的Span挂载到页数-1的下标链表上
-        std::unordered_map<PAGE_ID, SpanList::Span*> _spanMap; // 用于快速查找Span
+        size_t _node; // 本PageCache对应的节点下标
+        SpanList _spanList[MAX_PAGES]; // Span链表,对应页数的Span挂载到页数-1的下标链表上
+        SpanList _largeSpanList; // 页数超过MAX_PAGES的空闲Span，数量少，按最佳适配线性查找
         // void* systemAlloc(size_t numPages); // 直接与操作系统交互通过mmap申请大块内存
         DtLenMemoryPool<SpanList::Span> _spanPool; // 定长内存池，用于Span的分配
+        // 后台回收线程只有一个，由节点0的实例保存其状态
+        std::thread _scavenger; // 后台回收线程
+        std::mutex _mutexScavenger; // 保护_scavenger的启停以及配合条件变量唤醒
+        std::condition_variable _scavengerCond;
+        bool _scavengerStop = false;
+        HugePageArena _arena; // 大页模式下新内存的来源
+        bool _hugePages = false; // 由_mutexPage保护
+        uint64_t _largeAllocs = 0; // 大对象分配、释放次数以及正在使用的字节数，由_mutexPage保护
+        uint64_t _largeFrees = 0;
+        size_t _largeBytes = 0;
+        size_t _systemPages = 0; // 本节点向系统申请的页数，由_mutexPage保护
+        uint64_t _borrowedSpans = 0; // 从其他节点借用的Span数，由_mutexPage保护
     };
 
+    // 首次使用时在静态存储上构造且从不析构：不依赖跨编译单元的静态初始化顺序，
+    // 替换malloc时在其他静态对象初始化期间以及析构期间都能安全使用；构造过程不能调用malloc
+    // 不析构也意味着进程退出时不会等待后台回收线程，需要时由使用者调用stopScavenger
+    inline PageCache& PageCache::getInstance(size_t node) {
+        struct Instances { // 一次构造所有节点的实例，之后按下标无锁访问
+            PageCache* _nodes[MAX_NUMA_NODES];
+            Instances() {
+                alignas(PageCache) static char storage[MAX_NUMA_NODES][sizeof(PageCache)]; // 未用到的节点不会被访问，不占物理内存
+                for(size_t i = 0; i < NumaTopology::getInstance().nodeCount(); i++) _nodes[i] = new(storage[i]) PageCache(i);
+            }
+        };
+        alignas(Instances) static char storage[sizeof(Instances)];
+        static Instances* instances = new(storage) Instances();
+        return *instances->_nodes[node];
+    }
+
+    inline PageCache& PageCache::getInstance() {
+        return getInstance(NumaTopology::getInstance().currentNode());
+    }
+
+    inline SpanPageMap& PageCache::pageMap() {
+        alignas(SpanPageMap) static char storage[sizeof(SpanPageMap)]; // 零初始化，页表根节点依赖于此
+        static SpanPageMap* instance = new(storage) SpanPageMap; // 默认初始化，不逐项写零
+        return *instance;
+    }
+
+    inline SpanList::Span* PageCache::getIdOfSpan(void* ptr) {
+        PAGE_ID id = ((PAGE_ID)ptr >> PAGE_SHIFT);
+        return pageMap().get(id); // 基数树的读操作无锁，正在使用的Span的页表项不会被并发修改
+    }
+
 } // namespace MyMemoryPool
\ No newline at end of file
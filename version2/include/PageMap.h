@@ -0,0 +1,108 @@
+#pragma once
+#include "MemoryPool.h"
+#include <atomic>
+
+namespace MyMemoryPool {
+
+    // 基数树页表：页号 -> Span*
+    // 读操作不加锁（原子load）；各NUMA节点的PageCache共用一个页表，每一项只由该页所属节点的_mutexPage保护写入，
+    // 中间节点和叶子节点可能被多个节点共用，创建时由PageCache的页表锁保护
+    // 节点一经创建就不再释放，因此无锁读者不会访问到已释放的节点
+    // 注意：根节点数组依赖静态存储期的零初始化，只能作为单例的成员使用
+
+    template<int BITS>
+    class PageMap2 { // 两层基数树，适用于32位系统
+    public:
+        SpanList::Span* get(PAGE_ID id) const { // 无锁查询，页号未登记时返回nullptr
+            if((id >> BITS) > 0) return nullptr;
+            Leaf* leaf = _root[id >> LEAF_BITS].load(std::memory_order_acquire);
+            if(leaf == nullptr) return nullptr;
+            return leaf->_values[id & (LEAF_LENGTH - 1)].load(std::memory_order_acquire);
+        }
+        void set(PAGE_ID id, SpanList::Span* span) { // 调用前需ensure，且持有PageCache的锁
+            Leaf* leaf = _root[id >> LEAF_BITS].load(std::memory_order_relaxed);
+            leaf->_values[id & (LEAF_LENGTH - 1)].store(span, std::memory_order_release);
+        }
+        bool ensure(PAGE_ID start, size_t numPages) { // 确保[start, start + numPages)对应的叶子节点存在
+            for(PAGE_ID key = start; key < start + numPages;) {
+                if((key >> BITS) > 0) return false;
+                std::atomic<Leaf*>& slot = _root[key >> LEAF_BITS];
+                if(slot.load(std::memory_order_relaxed) == nullptr) {
+                    Leaf* leaf = static_cast<Leaf*>(systemAlloc(pagesOf(sizeof(Leaf))));
+                    if(leaf == nullptr) return false;
+                    slot.store(leaf, std::memory_order_release); // mmap得到的内存已清零，相当于全部为nullptr
+                }
+                key = ((key >> LEAF_BITS) + 1) << LEAF_BITS; // 跳到下一个叶子节点
+            }
+            return true;
+        }
+    private:
+        static const int ROOT_BITS = 5;
+        static const int LEAF_BITS = BITS - ROOT_BITS;
+        static const size_t ROOT_LENGTH = size_t(1) << ROOT_BITS;
+        static const size_t LEAF_LENGTH = size_t(1) << LEAF_BITS;
+        struct Leaf {
+            std::atomic<SpanList::Span*> _values[LEAF_LENGTH];
+        };
+        static size_t pagesOf(size_t bytes) { return (bytes + PAGE_SIZE - 1) >> PAGE_SHIFT; }
+        std::atomic<Leaf*> _root[ROOT_LENGTH];
+    };
+
+    template<int BITS>
+    class PageMap3 { // 三层基数树，适用于64位系统（48位虚拟地址空间）
+    public:
+        SpanList::Span* get(PAGE_ID id) const { // 无锁查询，页号未登记时返回nullptr
+            if((id >> BITS) > 0) return nullptr;
+            Node* node = _root[id >> (LEAF_BITS + INTERIOR_BITS)].load(std::memory_order_acquire);
+            if(node == nullptr) return nullptr;
+            Leaf* leaf = node->_children[(id >> LEAF_BITS) & (INTERIOR_LENGTH - 1)].load(std::memory_order_acquire);
+            if(leaf == nullptr) return nullptr;
+            return leaf->_values[id & (LEAF_LENGTH - 1)].load(std::memory_order_acquire);
+        }
+        void set(PAGE_ID id, SpanList::Span* span) { // 调用前需ensure，且持有PageCache的锁
+            Node* node = _root[id >> (LEAF_BITS + INTERIOR_BITS)].load(std::memory_order_relaxed);
+            Leaf* leaf = node->_children[(id >> LEAF_BITS) & (INTERIOR_LENGTH - 1)].load(std::memory_order_relaxed);
+            leaf->_values[id & (LEAF_LENGTH - 1)].store(span, std::memory_order_release);
+        }
+        bool ensure(PAGE_ID start, size_t numPages) { // 确保[start, start + numPages)对应的中间节点和叶子节点存在
+            for(PAGE_ID key = start; key < start + numPages;) {
+                if((key >> BITS) > 0) return false;
+                std::atomic<Node*>& rootSlot = _root[key >> (LEAF_BITS + INTERIOR_BITS)];
+                if(rootSlot.load(std::memory_order_relaxed) == nullptr) {
+                    Node* node = static_cast<Node*>(systemAlloc(pagesOf(sizeof(Node))));
+                    if(node == nullptr) return false;
+                    rootSlot.store(node, std::memory_order_release);
+                }
+                Node* node = rootSlot.load(std::memory_order_relaxed);
+                std::atomic<Leaf*>& leafSlot = node->_children[(key >> LEAF_BITS) & (INTERIOR_LENGTH - 1)];
+                if(leafSlot.load(std::memory_order_relaxed) == nullptr) {
+                    Leaf* leaf = static_cast<Leaf*>(systemAlloc(pagesOf(sizeof(Leaf))));
+                    if(leaf == nullptr) return false;
+                    leafSlot.store(leaf, std::memory_order_release);
+                }
+                key = ((key >> LEAF_BITS) + 1) << LEAF_BITS; // 跳到下一个叶子节点
+            }
+            return true;
+        }
+    private:
+        static const int INTERIOR_BITS = (BITS + 2) / 3; // 前两层平分，剩余位数给叶子层
+        static const int LEAF_BITS = BITS - 2 * INTERIOR_BITS;
+        static const size_t INTERIOR_LENGTH = size_t(1) << INTERIOR_BITS;
+        static const size_t LEAF_LENGTH = size_t(1) << LEAF_BITS;
+        struct Leaf {
+            std::atomic<SpanList::Span*> _values[LEAF_LENGTH];
+        };
+        struct Node {
+            std::atomic<Leaf*> _children[INTERIOR_LENGTH];
+        };
+        static size_t pagesOf(size_t bytes) { return (bytes + PAGE_SIZE - 1) >> PAGE_SHIFT; }
+        std::atomic<Node*> _root[INTERIOR_LENGTH];
+    };
+
+    #if defined(__x86_64__) || defined(_M_X64) || defined(__aarch64__)
+        typedef PageMap3<48 - PAGE_SHIFT> SpanPageMap; // 48位虚拟地址，36位页号，12/12/12三层
+    #else
+        typedef PageMap2<32 - PAGE_SHIFT> SpanPageMap; // 32位地址，20位页号，5/15两层
+    #endif
+
+} // namespace MyMemoryPool
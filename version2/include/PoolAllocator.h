@@ -0,0 +1,89 @@
+#pragma once
+#include "UseMemoryPool.h"
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define MEMORYPOOL_HAS_PMR 1
+#endif
+#endif
+
+namespace MyMemoryPool {
+
+    // 满足标准库Allocator要求的分配器，容器的节点和小数组直接按大小进入对应的size class：
+    // std::map<K, V, std::less<K>, PoolAllocator<std::pair<const K, V>>>、std::list<T, PoolAllocator<T>>等
+    // 容器通过rebind为节点类型分配，每次分配的大小在编译期已知，释放时带上大小，不需要查页表
+    // 所有实例共享同一个内存池，可以互相释放对方分配的内存，因此总是相等，容器交换、移动时不需要逐个重新分配
+    // 与标准分配器一致，内存不足时抛出std::bad_alloc
+    template<typename T>
+    class PoolAllocator {
+    public:
+        typedef T value_type;
+        typedef std::true_type is_always_equal;
+        typedef std::true_type propagate_on_container_move_assignment;
+
+        PoolAllocator() noexcept {}
+        template<typename U>
+        PoolAllocator(const PoolAllocator<U>&) noexcept {}
+
+        T* allocate(size_t n) {
+            if(n > std::numeric_limits<size_t>::max() / sizeof(T)) throw std::bad_array_new_length();
+            size_t bytes = n * sizeof(T);
+            if(bytes == 0) bytes = 1;
+            // size class只保证8字节对齐，更严格的对齐改为选一个大小是对齐倍数的size class
+            void* ptr = alignof(T) <= 8 ? localAllocate(bytes) : localAllocateAligned(bytes, alignof(T));
+            if(ptr == nullptr) throw std::bad_alloc();
+            return static_cast<T*>(ptr);
+        }
+
+        void deallocate(T* ptr, size_t n) noexcept {
+            size_t bytes = n * sizeof(T);
+            if(bytes == 0) bytes = 1;
+            if(alignof(T) <= 8) localDeallocate(ptr, bytes);
+            else localDeallocateAligned(ptr, bytes, alignof(T));
+        }
+    };
+
+    template<typename T, typename U>
+    inline bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+    template<typename T, typename U>
+    inline bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+
+#ifdef MEMORYPOOL_HAS_PMR
+    // std::pmr的内存资源，需要以C++17编译（CMake选项MEMORYPOOL_CXX17）
+    // std::pmr::map等容器可以直接使用：std::pmr::map<int, int> m(&poolResource())；
+    // 也可以调用setDefaultPoolResource()作为进程的默认资源，之后未指定资源的pmr容器都从内存池分配
+    // 资源本身没有状态，所有实例等价，可以互相释放对方分配的内存
+    class PoolMemoryResource : public std::pmr::memory_resource {
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            if(bytes == 0) bytes = 1;
+            void* ptr = alignment <= 8 ? localAllocate(bytes) : localAllocateAligned(bytes, alignment);
+            if(ptr == nullptr) throw std::bad_alloc();
+            return ptr;
+        }
+        void do_deallocate(void* ptr, size_t bytes, size_t alignment) override {
+            if(bytes == 0) bytes = 1;
+            if(alignment <= 8) localDeallocate(ptr, bytes);
+            else localDeallocateAligned(ptr, bytes, alignment);
+        }
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other || dynamic_cast<const PoolMemoryResource*>(&other) != nullptr;
+        }
+    };
+
+    inline PoolMemoryResource& poolResource() { // 进程内共用的实例，从不析构，静态对象析构期间仍可使用
+        alignas(PoolMemoryResource) static char storage[sizeof(PoolMemoryResource)];
+        static PoolMemoryResource* instance = new(storage) PoolMemoryResource();
+        return *instance;
+    }
+
+    inline std::pmr::memory_resource* setDefaultPoolResource() { // 返回之前的默认资源
+        return std::pmr::set_default_resource(&poolResource());
+    }
+#endif
+
+} // namespace MyMemoryPool
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+
+// 由MemoryPool.h在定义MAX_BYTES等常量之后包含
+namespace MyMemoryPool {
+
+    // size class的划分规则：step(size)返回包含size的那一段中相邻size class的间隔
+    // 从0开始不断加上间隔即得到所有size class，最后一个必须恰好是MAX_BYTES
+    // 间隔需为2的幂且不小于8；超过SIZE_CLASS_SMALL_LOOKUP的size class还需是LARGE_GRANULE的倍数，查表时按该粒度分段
+    struct DefaultSizeClassPolicy { // 原有的分段对齐规则，共216个size class，内碎片控制在11%左右，最大一段每个对象最多浪费32KB
+        static constexpr size_t LARGE_GRANULE = 128;
+        static constexpr size_t step(size_t size) {
+            return size <= 128 ? 8 // 小于等于128字节，按照8字节对齐
+                : size <= 1024 ? 16 // 小于等于1024字节，按照16字节对齐
+                : size <= 8 * 1024 ? 128 // 小于等于8KB，按照128字节对齐
+                : size <= 64 * 1024 ? 1024 // 小于等于64KB，按照1024字节对齐
+                : size <= 256 * 1024 ? 8 * 1024 // 小于等于256KB，按照8KB对齐
+                : 32 * 1024; // 小于等于512KB，按照32KB对齐
+        }
+    };
+
+    struct FineSizeClassPolicy { // 超过128字节后每个2的幂区间均分为16段，内碎片不超过1/16，最大一段每个对象最多浪费16KB，共208个size class
+        static constexpr size_t LARGE_GRANULE = 64;
+        static constexpr size_t step(size_t size) {
+            if(size <= 128) return 8;
+            size_t low = 128;
+            while(low * 2 < size) low *= 2; // size所在区间(low, 2*low]
+            return low / 16;
+        }
+    };
+
+    #define SIZE_CLASS_SMALL_LOOKUP 1024 // 不超过此大小时按8字节粒度查表，否则按策略的LARGE_GRANULE粒度查表
+
+    template<typename Policy>
+    constexpr size_t countSizeClasses() {
+        size_t count = 0;
+        for(size_t size = 0; size < MAX_BYTES; size += Policy::step(size + 1)) count++;
+        return count;
+    }
+
+    template<typename Policy>
+    constexpr size_t sizeClassLookupIndex(size_t size) { // size -> 查表下标，同一个下标覆盖的大小一定落在同一个size class
+        return size <= SIZE_CLASS_SMALL_LOOKUP ? (size + 7) >> 3
+            : SIZE_CLASS_SMALL_LOOKUP / 8 + (size - SIZE_CLASS_SMALL_LOOKUP + Policy::LARGE_GRANULE - 1) / Policy::LARGE_GRANULE;
+    }
+
+    constexpr size_t sizeClassBatchNum(size_t size) { // 与CentralCache之间一次批量传输的数量
+        return MAX_BYTES / size < 2 ? 2 : MAX_BYTES / size > MAX_FREELIST_NUMBERS ? MAX_FREELIST_NUMBERS : MAX_BYTES / size;
+    }
+
+    constexpr size_t sizeClassPageNum(size_t size) { // CentralCache为该size class申请的Span页数，能容纳一批对象，不超过MAX_PAGES
+        return (sizeClassBatchNum(size) * size + PAGE_SIZE - 1) / PAGE_SIZE > MAX_PAGES ? MAX_PAGES
+            : (sizeClassBatchNum(size) * size + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
+
+    template<typename Policy>
+    struct SizeClassData { // 编译期生成的各项表格
+        static constexpr size_t NUM_CLASSES = countSizeClasses<Policy>();
+        static constexpr size_t LOOKUP_SIZE = sizeClassLookupIndex<Policy>(MAX_BYTES) + 1;
+        static_assert(NUM_CLASSES <= 256, "size class下标按uint8_t存放");
+        size_t _size[NUM_CLASSES]; // size class -> 对齐后的大小
+        uint16_t _batch[NUM_CLASSES]; // size class -> 批量传输的数量
+        uint16_t _pages[NUM_CLASSES]; // size class -> Span页数
+        uint8_t _lookup[LOOKUP_SIZE]; // 查表下标 -> size class
+        bool _valid; // 策略是否满足上面的约束
+
+        constexpr SizeClassData() : _size(), _batch(), _pages(), _lookup(), _valid(true) {
+            size_t size = 0;
+            for(size_t i = 0; i < NUM_CLASSES; i++){
+                size_t step = Policy::step(size + 1);
+                if(step < 8 || (step & (step - 1)) != 0) _valid = false;
+                size += step;
+                if(size > SIZE_CLASS_SMALL_LOOKUP && size % Policy::LARGE_GRANULE != 0) _valid = false;
+                _size[i] = size;
+                _batch[i] = sizeClassBatchNum(size);
+                _pages[i] = sizeClassPageNum(size);
+            }
+            if(size != MAX_BYTES) _valid = false;
+            size_t index = 0;
+            for(size_t k = 1; k < LOOKUP_SIZE; k++){
+                size_t maxSize = k <= SIZE_CLASS_SMALL_LOOKUP / 8 ? k * 8 // 下标k覆盖的最大字节数
+                    : SIZE_CLASS_SMALL_LOOKUP + (k - SIZE_CLASS_SMALL_LOOKUP / 8) * Policy::LARGE_GRANULE;
+                while(_size[index] < maxSize) index++;
+                _lookup[k] = index;
+            }
+        }
+    };
+
+    template<typename Policy>
+    struct SizeClassTables {
+        static constexpr SizeClassData<Policy> _data{};
+        static_assert(_data._valid, "size class策略不满足间隔与粒度的约束");
+    };
+    template<typename Policy>
+    constexpr SizeClassData<Policy> SizeClassTables<Policy>::_data;
+
+    template<typename Policy>
+    class SizeClassMap { // 所有查询都是一次查表，没有分支链和运行时的求和
+    public:
+        static constexpr size_t NUM_CLASSES = SizeClassData<Policy>::NUM_CLASSES;
+        static inline size_t getIndex(size_t size) { // size -> size class下标
+            assert(size > 0 && size <= MAX_BYTES);
+            return SizeClassTables<Policy>::_data._lookup[sizeClassLookupIndex<Policy>(size)];
+        }
+        static inline size_t alignMemory(size_t size) { // size -> 对齐后的大小
+            return classSize(getIndex(size));
+        }
+        static inline size_t classSize(size_t index) { // size class下标 -> 对齐后的大小，是getIndex的逆运算
+            assert(index < NUM_CLASSES);
+            return SizeClassTables<Policy>::_data._size[index];
+        }
+        static inline size_t batchNum(size_t index) { return SizeClassTables<Policy>::_data._batch[index]; }
+        static inline size_t pageNum(size_t index) { return SizeClassTables<Policy>::_data._pages[index]; }
+        static inline size_t normBatchNum(size_t size) { // 规范化批量分配的数量
+            return batchNum(getIndex(size));
+        }
+        static inline size_t normPageNum(size_t size) {
+            return pageNum(getIndex(size));
+        }
+    };
+
+} // namespace MyMemoryPool
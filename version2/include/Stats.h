@@ -0,0 +1,96 @@
+#pragma once
+#include "MemoryPool.h"
+#include "NumaTopology.h"
+#include <atomic>
+#include <ostream>
+
+namespace MyMemoryPool {
+
+    // 统计信息：ThreadCache的计数器按线程独立、只由所属线程写入，快速路径上只有一次relaxed的读加写，不需要原子RMW
+    // 汇总时遍历所有存活的ThreadCache读取计数器，线程退出时计数器并入全局累计值
+    // 定义MEMORYPOOL_NO_STATS可以去掉ThreadCache上的计数器，用于对比统计本身的开销（此时ThreadCache相关的统计为0）
+    #ifndef MEMORYPOOL_NO_STATS
+        #define STAT_ADD(counter, n) statAdd(counter, n)
+    #else
+        #define STAT_ADD(counter, n) ((void)0)
+    #endif
+
+    static inline void statAdd(std::atomic<uint64_t>& counter, uint64_t n) { // 只有一个写者时使用，其他线程可以随时读取
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    struct ThreadCacheStats { // 每个ThreadCache与CentralCache交互的计数器，下标为size class；分配释放次数与自由链表放在一起
+        std::atomic<uint64_t> _fetches[FREE_LIST_SIZE]; // 向CentralCache批量获取的次数
+        std::atomic<uint64_t> _fetchedObjects[FREE_LIST_SIZE]; // 批量获取到的对象总数
+        std::atomic<uint64_t> _returns[FREE_LIST_SIZE]; // 向CentralCache批量归还的次数
+        std::atomic<uint64_t> _returnedObjects[FREE_LIST_SIZE]; // 批量归还的对象总数
+        std::atomic<uint64_t> _remoteFrees[FREE_LIST_SIZE]; // 放入其他线程跨线程释放队列的对象数
+        std::atomic<uint64_t> _remoteCollects[FREE_LIST_SIZE]; // 从本线程的跨线程释放队列取回的对象数
+        ThreadCacheStats() {
+            for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+                _fetches[i].store(0, std::memory_order_relaxed);
+                _fetchedObjects[i].store(0, std::memory_order_relaxed);
+                _returns[i].store(0, std::memory_order_relaxed);
+                _returnedObjects[i].store(0, std::memory_order_relaxed);
+                _remoteFrees[i].store(0, std::memory_order_relaxed);
+                _remoteCollects[i].store(0, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct SizeClassStats { // 单个size class的快照
+        size_t _objSize = 0; // 对齐后的对象大小
+        uint64_t _allocs = 0; // ThreadCache分配次数
+        uint64_t _frees = 0; // ThreadCache释放次数
+        uint64_t _fetches = 0; // ThreadCache向CentralCache批量获取的次数
+        uint64_t _returns = 0; // ThreadCache向CentralCache批量归还的次数
+        uint64_t _remoteFrees = 0; // 放入其他线程跨线程释放队列的次数（也计入_frees）
+        uint64_t _remoteCollects = 0; // 所有者从跨线程释放队列取回的对象数，与_remoteFrees之差为还在队列中的对象
+        size_t _threadCacheBytes = 0; // 所有ThreadCache中缓存的字节数
+        size_t _transferCacheBytes = 0; // TransferCache中缓存的字节数
+        size_t _centralCacheBytes = 0; // CentralCache的Span中空闲的字节数
+        size_t _spans = 0; // CentralCache持有的Span数
+    };
+
+    struct PageListStats { // PageCache中一条空闲链表的快照
+        size_t _spans = 0;
+        size_t _pages = 0;
+        size_t _releasedPages = 0; // 已经归还给操作系统的页数
+    };
+
+    struct NodeStats { // 单个NUMA节点的快照
+        size_t _systemBytes = 0; // 该节点的PageCache向系统申请（并绑定到该节点）的字节数
+        size_t _pageCacheBytes = 0; // 该节点PageCache中空闲的字节数
+        size_t _releasedBytes = 0;
+        size_t _largeObjectBytes = 0; // 属于该节点、正在使用的大对象的字节数
+        size_t _centralCacheBytes = 0; // 该节点CentralCache的Span中空闲的字节数
+        uint64_t _borrowedSpans = 0; // 该节点内存不足时从其他节点借用的Span数
+    };
+
+    struct PoolStats { // 整个内存池的快照，由getPoolStats填充
+        SizeClassStats _classes[FREE_LIST_SIZE];
+        PageListStats _pageLists[MAX_PAGES + 1]; // 下标i对应i+1页的Span，最后一项为页数超过MAX_PAGES的Span
+        size_t _threads = 0; // 存活的ThreadCache数
+        size_t _threadCacheBytes = 0; // 所有ThreadCache当前缓存的字节数，按各线程维护的精确值汇总
+        // 所有ThreadCache当前容量之和，包括被窃取后尚未归还的部分；新线程总能取得最小容量，预算不足时可能暂时超过_threadCacheBudget
+        size_t _threadCacheLimit = 0;
+        size_t _threadCacheBudget = 0; // ThreadCache容量之和的上限
+        size_t _cpuCacheBytes = 0;
+        size_t _transferCacheBytes = 0;
+        size_t _centralCacheBytes = 0;
+        size_t _remoteFreeBytes = 0; // 还在跨线程释放队列中、等待所有者取回的字节数
+        uint64_t _remoteFrees = 0;
+        size_t _pageCacheBytes = 0; // PageCache中空闲的字节数，包含已归还给操作系统的部分
+        size_t _releasedBytes = 0; // 已归还给操作系统的字节数
+        size_t _largeObjectBytes = 0; // 正在使用的大对象占用的字节数
+        uint64_t _largeAllocs = 0;
+        uint64_t _largeFrees = 0;
+        size_t _mappedBytes = 0; // 通过mmap向操作系统申请的总字节数，包括元数据
+        size_t _numaNodes = 1; // PageCache和CentralCache划分的节点数
+        NodeStats _nodes[MAX_NUMA_NODES];
+    };
+
+    void collectPoolStats(PoolStats& stats); // 汇总各层的统计信息，每层只在读取自身状态时短暂加锁
+    void printPoolStats(std::ostream& os, const PoolStats& stats, bool json); // 输出为可读文本或JSON
+
+} // namespace MyMemoryPool
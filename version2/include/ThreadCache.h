@@ -1,32 +1,151 @@
 #pragma once
 #include "MemoryPool.h"
+#include "Stats.h"
+#include "HeapProfiler.h"
+#include <pthread.h>
 
 namespace MyMemoryPool {
 
+// 一个线程的跨线程释放队列：每个size class一条无锁的多生产者单消费者链表，链表指针存放在内存块的头8字节
+// 其他线程用CAS头插单个内存块，所有者用exchange一次取走整条链表，不存在ABA问题
+// 所有者退出时把链表头换成REMOTE_FREE_CLOSED，此后的释放者放弃入队、改为放入自己的缓存
+// 队列随所有者编号分配后一直保留，编号被新线程复用时重新打开，释放者读到过期的编号也不会访问到已回收的内存
+static const uintptr_t REMOTE_FREE_CLOSED = 1;
+
+struct RemoteFreeQueue {
+    std::atomic<uintptr_t> _heads[FREE_LIST_SIZE];
+    uint32_t _ownerId = 0; // 以下两项由ThreadCache的_registryMutex保护
+    RemoteFreeQueue* _nextFree = nullptr; // 所有者已退出、等待复用的队列组成的栈
+    RemoteFreeQueue() {
+        for(size_t i = 0; i < FREE_LIST_SIZE; i++) _heads[i].store(0, std::memory_order_relaxed);
+    }
+    bool push(size_t index, void* ptr) { // 队列已关闭时返回false
+        uintptr_t head = _heads[index].load(std::memory_order_relaxed);
+        do {
+            if(head == REMOTE_FREE_CLOSED) return false;
+            ptrNext(ptr) = reinterpret_cast<void*>(head);
+        } while(!_heads[index].compare_exchange_weak(head, reinterpret_cast<uintptr_t>(ptr),
+            std::memory_order_release, std::memory_order_relaxed));
+        return true;
+    }
+    void* popAll(size_t index) { // 只由所有者调用，先做一次普通读取，队列为空时不写共享的缓存行
+        uintptr_t head = _heads[index].load(std::memory_order_relaxed);
+        if(head == 0 || head == REMOTE_FREE_CLOSED) return nullptr;
+        return reinterpret_cast<void*>(_heads[index].exchange(0, std::memory_order_acquire));
+    }
+    void* close(size_t index) { // 所有者退出时调用，返回关闭前还在队列中的内存块
+        return reinterpret_cast<void*>(_heads[index].exchange(REMOTE_FREE_CLOSED, std::memory_order_acquire));
+    }
+    void open() { // 编号被新线程复用时调用，关闭状态下没有其他线程会写链表头
+        for(size_t i = 0; i < FREE_LIST_SIZE; i++) _heads[i].store(0, std::memory_order_relaxed);
+    }
+};
+
 class ThreadCache {
 public:
     // static ThreadCache& getInstance() { 
     //     return _instance;
     // }
-    ThreadCache() : _freeList(FREE_LIST_SIZE, nullptr), 
-                    _freeListLength(FREE_LIST_SIZE, 0)
-                    {}
+    ThreadCache() { // 不使用std::vector，替换malloc时创建ThreadCache不能再调用malloc
+        for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+            _freeList[i]._head = nullptr;
+            _freeList[i]._length = 0;
+            _freeList[i]._lowWater = 0;
+            _freeList[i]._maxLength = 1; // 慢开始：第一次只取一个
+            _freeList[i]._overages = 0;
+            _freeList[i]._allocs.store(0, std::memory_order_relaxed);
+            _freeList[i]._frees.store(0, std::memory_order_relaxed);
+        }
+    }
     void* allocate(size_t size);
     void deallocate(void* ptr, size_t size);
-    static size_t getBatchNum(size_t index) { // 获取批量分配的数量
-        if(_batchNum[index] == MAX_FREELIST_NUMBERS) return MAX_FREELIST_NUMBERS;
-        return _batchNum[index]++;
-    }
+    // 不经过allocate、直接向PageCache申请的大对象在分配后调用，与allocate一样扣减采样倒计数，减到负数时记录ptr
+    void* countAllocation(void* ptr, size_t size);
+    // 批量分配n个同样大小的对象：先取自由链表，不够的部分整条链表向CentralCache申请，多取的挂回自由链表
+    // 返回分配到的个数，只有大对象在内存不足时才会少于n
+    size_t allocateBatch(size_t size, size_t n, void** out);
+    // 批量释放：自由链表还放得下的部分串成一条链表放入，超出的部分每满一批直接交给CentralCache（优先进入TransferCache）
+    // 不区分内存块的所有者，开启跨线程释放时也不放入其他线程的队列
+    void deallocateBatch(size_t size, size_t n, void** ptrs);
+    void releaseAll(); // 将所有自由链表中的内存块按桶批量归还给CentralCache
+    static ThreadCache* createThreadCache(); // 为当前线程创建ThreadCache，并注册线程退出时的回收回调
+    static void lockAll() { _registryMutex.lock(); _tcPool.lock(); _queuePool.lock(); } // fork前加锁，保证子进程中ThreadCache对象池的状态一致
+    static void unlockAll() { _queuePool.unlock(); _tcPool.unlock(); _registryMutex.unlock(); }
+    static void collectStats(PoolStats& stats); // 汇总所有存活ThreadCache和已退出线程的计数器
+    static void setBudget(size_t bytes); // 调整所有ThreadCache缓存字节数之和的上限，超出的部分由各线程在之后的释放中逐步归还
+    // 开启后，释放其他线程从CentralCache取走的内存块时放入该线程的跨线程释放队列，由它在慢路径上整批取回；
+    // 生产者/消费者模式下内存不再单向堆积在释放方，分配方也不必反复向CentralCache申请。代价是每次释放多一次页表查询
+    static void setRemoteFreeMode(bool enabled) { _remoteFreeMode.store(enabled, std::memory_order_relaxed); }
+    // 设置堆采样的平均间隔（字节），0关闭；同时重置所有存活线程的倒计数，使新的间隔立即生效
+    static void setSampleInterval(size_t bytes);
 private:
+    void* allocateObject(size_t size); // 不检查采样的分配，allocate和allocateSampled共用
+    __attribute__((noinline)) void* allocateSampled(size_t size); // 倒计数减到负数时进入：分配后交给HeapProfiler重新抽取间隔并记录
+    void deallocateObject(void* ptr, size_t size); // 小对象释放，deallocate和deallocateSampled共用
+    __attribute__((noinline)) void deallocateSampled(void* ptr, size_t size); // 对象可能被采样过时进入：从存活表中移除后释放
     void* getMemoryFromCentralCache(size_t index, size_t alignedSize);
-    void returnMemoryToCentralCache(void*& freelist, size_t size);
-    bool isReturnToCentralCache(size_t index);
+    void returnMemoryToCentralCache(size_t index, size_t alignedSize, size_t num); // 从自由链表头部取num个内存块归还
+    // 以下两个慢路径不内联，避免释放的快速路径因为内联了大函数而需要保存更多寄存器
+    __attribute__((noinline)) void listTooLong(size_t index, size_t alignedSize); // 自由链表超过_maxLength时归还一批，并调整_maxLength
+    // 缓存字节数超过_maxSize时每个自由链表归还_lowWater的一半，然后尝试扩大容量；仍然超出时归还到容量以内，并偿还被窃取的容量
+    __attribute__((noinline)) void scavenge();
+    void shrinkToLimit(); // 从大对象的自由链表开始按批归还，直到缓存字节数不超过_maxSize的3/4
+    void repayOwed(); // 缓存字节数已在容量以内时，把_owedBytes还给预算，需持有_registryMutex
+    void pushFreeList(void* ptr, size_t index, size_t alignedSize); // 释放到本线程的自由链表
+    // ptr属于其他线程时放入它的跨线程释放队列，否则放入本线程的自由链表
+    __attribute__((noinline)) void freeRemote(void* ptr, size_t index, size_t alignedSize);
+    size_t collectRemoteFrees(size_t index, size_t alignedSize); // 取回本线程队列中的内存块放入自由链表，超出一批的部分归还给CentralCache
+    void closeRemoteFrees(); // 线程退出时关闭队列，将剩余的内存块归还给CentralCache
+    // 从未分配的预算或其他线程处获得THREAD_CACHE_STEAL_SIZE的容量，需持有_registryMutex
+    // 从其他线程窃取时只有对方容量中没有被缓存占用的部分立即计入，其余部分记在对方的_owedBytes上，等它归还内存后才回到预算
+    // 预算超额时本线程让出的容量同样先记在_owedBytes上
+    void increaseCacheLimit();
+    static void destroyThreadCache(void* ptr); // 线程退出时由pthread调用，归还内存并回收ThreadCache对象
+    static void createThreadKey();
 private:
-    std::vector<void*> _freeList; // 自由链表数组
-    std::vector<size_t> _freeListLength; // 自由链表长度数组
-    static std::vector<size_t> _batchNum; // 批量分配的数量,采用慢开始调节算法
+    struct alignas(32) FreeList { // 链表头、长度和快速路径上的计数器放在一起，每次分配释放只访问一个缓存行
+        void* _head;
+        uint16_t _length; // 不超过_maxLength加一批，16位足够
+        uint16_t _lowWater; // 上次scavenge以来的最小长度，这部分对象一直没有用到，scavenge时归还其中一半
+        uint16_t _maxLength; // 自由链表允许的最大长度，按慢开始算法随使用增长
+        uint16_t _overages; // 连续超出_maxLength的次数，超过MAX_OVERAGES次后缩小_maxLength
+        std::atomic<uint64_t> _allocs; // 分配次数，只由本线程写入
+        std::atomic<uint64_t> _frees; // 释放次数
+    };
+    FreeList _freeList[FREE_LIST_SIZE]; // 自由链表数组
+    // 当前缓存的字节数，只由本线程写入，统计时由其他线程读取
+    std::atomic<size_t> _size{0};
+    // 当前容量，其他线程窃取容量时会减小它，由_registryMutex保护写入，本线程在快速路径上无锁读取
+    std::atomic<size_t> _maxSize{0};
+    // 距离下一次堆采样还剩的字节数，只由本线程在分配时递减，setSampleInterval时由其他线程重置
+    std::atomic<ptrdiff_t> _sampleCountdown{HEAP_PROFILE_DISABLED_BYTES};
+    uint64_t _sampleState = 0; // 抽取采样间隔的随机数状态，创建时设置
+    uint64_t _lastGrowNs = 0; // 最近一次尝试扩大容量的时间，由_registryMutex保护
+    // 已从_maxSize中扣除（被窃取或主动让出）、但可能仍被本线程缓存占用的容量，由_registryMutex保护；本线程归还内存后才还给预算
+    // 因此空闲线程即使一直不释放，被窃取的容量也不会被其他线程重复使用，缓存总量始终受预算约束
+    size_t _owedBytes = 0;
+    ThreadCacheStats _stats; // 本线程与CentralCache交互的计数器，只由本线程写入
+    uint32_t _ownerId = 0; // 跨线程释放的所有者编号，0表示编号已用完、不接收其他线程的释放
+    RemoteFreeQueue* _remoteQueue = nullptr; // 编号对应的队列，没有编号时为nullptr
+    ThreadCache* _prevTC = nullptr; // 所有存活ThreadCache组成的双向链表，供统计和窃取容量时遍历
+    ThreadCache* _nextTC = nullptr;
     static ThreadCache _instance; // 单例模式
+    static DtLenMemoryPool<ThreadCache> _tcPool; // 定长内存池，用于分配ThreadCache的内存，线程退出后对象在此复用
+    static pthread_key_t _threadKey; // 仅用于在线程退出时触发destroyThreadCache
+    static pthread_once_t _threadKeyOnce;
+    static std::mutex _registryMutex; // 保护存活ThreadCache链表、容量预算和已退出线程的累计计数
+    static ThreadCache* _registryHead;
+    static ThreadCache* _stealCursor; // 下一次窃取容量的起点，轮流从各线程窃取
+    static size_t _budget; // 所有ThreadCache容量之和的上限
+    static ptrdiff_t _unclaimedBudget; // 尚未分配给任何线程的容量，超额分配时为负
+    static SizeClassStats _retiredStats[FREE_LIST_SIZE]; // 已退出线程的分配、释放、批量获取、批量归还次数
+    static std::atomic<bool> _remoteFreeMode;
+    static DtLenMemoryPool<RemoteFreeQueue> _queuePool; // 队列从不回收，与编号一一对应
+    static std::atomic<RemoteFreeQueue*> _remoteQueues[MAX_REMOTE_FREE_OWNERS]; // 编号 -> 队列，释放者无锁读取
+    static uint32_t _nextOwnerId; // 以下两项由_registryMutex保护
+    static RemoteFreeQueue* _freeQueues; // 已退出线程留下的队列，连同编号一起复用
 };
 
-extern thread_local ThreadCache* ptrTLSThreadCache;
+// initial-exec模型：访问TLS不经过__tls_get_addr，后者在动态库中首次调用时可能会调用malloc
+extern thread_local ThreadCache* ptrTLSThreadCache __attribute__((tls_model("initial-exec")));
 } // namespace MyMemoryPool
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include "MemoryPool.h"
+#include <atomic>
+
+namespace MyMemoryPool {
+
+    #define TRANSFER_CACHE_SLOTS 32 // 每个size class最多缓存的批次数
+    #define TRANSFER_CACHE_BYTES (1024 * 1024) // 每个size class缓存的字节数上限，据此计算实际可用的批次数
+
+    // 位于ThreadCache与CentralCache之间的无锁环形缓冲区，每个元素是一整批已经串好的内存块(start/end)
+    // 一个线程归还的批次可以直接交给另一个线程，不需要拆回Span，也不需要加size class的锁
+    // 采用有界MPMC队列：每个槽位带一个序号，生产者和消费者分别CAS推进入队/出队位置
+    class TransferCache {
+    public:
+        TransferCache() {
+            for(size_t i = 0; i < TRANSFER_CACHE_SLOTS; i++){
+                _slots[i]._seq.store(i, std::memory_order_relaxed);
+            }
+        }
+        void init(size_t size) { // 根据size class对齐后的大小确定容量，大对象的批次占用内存多，容量相应变小
+            size_t batchBytes = SizeClass::normBatchNum(size) * size;
+            size_t capacity = TRANSFER_CACHE_BYTES / batchBytes;
+            if(capacity < 2) capacity = 2;
+            if(capacity > TRANSFER_CACHE_SLOTS) capacity = TRANSFER_CACHE_SLOTS;
+            _capacity = capacity;
+        }
+        bool push(void* start, void* end, size_t count); // 放入一批，缓冲区满时返回false
+        size_t pop(void*& start, void*& end); // 取出一批，返回内存块个数，缓冲区空时返回0
+        size_t popHits() const { return _popHits.load(std::memory_order_relaxed); }
+        size_t popMisses() const { return _popMisses.load(std::memory_order_relaxed); }
+        size_t pushHits() const { return _pushHits.load(std::memory_order_relaxed); }
+        size_t pushMisses() const { return _pushMisses.load(std::memory_order_relaxed); }
+        size_t cachedObjects() const { return _objects.load(std::memory_order_relaxed); } // 当前缓存的内存块总数，供统计使用
+    private:
+        struct Slot {
+            std::atomic<size_t> _seq; // 等于入队位置时可写，等于入队位置+1时可读
+            void* _start;
+            void* _end;
+            size_t _count;
+        };
+        Slot _slots[TRANSFER_CACHE_SLOTS];
+        size_t _capacity = TRANSFER_CACHE_SLOTS; // 实际使用的槽位数
+        alignas(64) std::atomic<size_t> _enqueuePos{0}; // 入队、出队位置分属不同缓存行，避免生产者与消费者互相干扰
+        alignas(64) std::atomic<size_t> _dequeuePos{0};
+        alignas(64) std::atomic<size_t> _popHits{0}; // 命中/未命中计数，relaxed原子操作
+        std::atomic<size_t> _popMisses{0};
+        std::atomic<size_t> _pushHits{0};
+        std::atomic<size_t> _pushMisses{0};
+        std::atomic<size_t> _objects{0};
+    };
+
+} // namespace MyMemoryPool
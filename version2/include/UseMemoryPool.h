@@ -1,23 +1,203 @@
 #pragma once
 #include "MemoryPool.h"
 #include "ThreadCache.h"
+#include "PageCache.h"
+#include "CpuCache.h"
+#include "CentralCache.h"
+#include "Stats.h"
 
 namespace MyMemoryPool {
     
-static void* localAllocate(size_t size) { // 实现线程的独立分配
+static inline void* localAllocate(size_t size) { // 实现线程的独立分配
     if(ptrTLSThreadCache == nullptr) {
-        static DtLenMemoryPool<ThreadCache> _tcPool; // 定长内存池，用于分配ThreadCache的内存
-        ptrTLSThreadCache = _tcPool.New();
+        ThreadCache::createThreadCache();
     }
     return ptrTLSThreadCache->allocate(size);
 }
 
-static void localDeallocate(void* ptr, size_t size) { // 实现线程的独立释放
+static inline void localDeallocate(void* ptr, size_t size) { // 实现线程的独立释放
+    if(ptrTLSThreadCache == nullptr) { // 线程从未分配过，或ThreadCache已在线程退出流程中被回收
+        ThreadCache::createThreadCache();
+    }
+    ptrTLSThreadCache->deallocate(ptr, size);
+}
+
+// 直接向PageCache申请的大对象（calloc、realloc增长、超过一页的对齐）都经过这里，与localAllocate一样计入本线程的堆采样
+static inline void* localCountLarge(void* ptr, size_t size) {
     if(ptrTLSThreadCache == nullptr) {
-        std::cerr << "Error: ThreadCache not initialized." << std::endl;
+        ThreadCache::createThreadCache();
+    }
+    return ptrTLSThreadCache->countAllocation(ptr, size);
+}
+
+static inline void localDeallocate(void* ptr) { // 无尺寸释放：通过页表找到所属Span，由Span记录的对象大小确定size class
+    if(ptr == nullptr) return;
+    SpanList::Span* span = PageCache::getIdOfSpan(ptr);
+    assert(span != nullptr && span->_isUse);
+    if(span->_objSize == 0) { // 大对象，整个Span归还给PageCache
+        PageCache::FreeLargeObject(ptr);
         return;
     }
-    ptrTLSThreadCache->deallocate(ptr, size);
+    localDeallocate(ptr, span->_objSize);
+}
+
+// 批量分配n个size字节的对象写入out，返回分配到的个数（只有大对象在内存不足时才会少于n）
+// 与逐个调用localAllocate相比，自由链表不够时整条链表向CentralCache申请，不会每个对象都走一遍ThreadCache的逻辑
+static inline size_t localAllocateBatch(size_t size, size_t n, void** out) {
+    if(ptrTLSThreadCache == nullptr) {
+        ThreadCache::createThreadCache();
+    }
+    return ptrTLSThreadCache->allocateBatch(size, n, out);
+}
+
+// 批量释放n个按size分配的对象，可以来自localAllocateBatch，也可以来自逐个的localAllocate
+static inline void localDeallocateBatch(size_t size, size_t n, void** ptrs) {
+    if(ptrTLSThreadCache == nullptr) {
+        ThreadCache::createThreadCache();
+    }
+    ptrTLSThreadCache->deallocateBatch(size, n, ptrs);
+}
+
+static inline size_t localUsableSize(void* ptr) { // 返回ptr实际可用的字节数，即所属size class对齐后的大小或大对象的整页大小
+    if(ptr == nullptr) return 0;
+    SpanList::Span* span = PageCache::getIdOfSpan(ptr);
+    if(span == nullptr) return 0;
+    if(span->_objSize == 0) {
+        return span->_numPages << PAGE_SHIFT;
+    }
+    return span->_objSize;
+}
+
+// 将ptr(由localAllocate(oldSize)分配)调整为newSize字节，返回调整后的指针，之后按newSize释放
+// 新旧大小落在同一个size class时直接返回ptr；都是大对象时原地缩小或吞并后面的空闲页来增大；只有这两种情况都不满足时才重新分配并拷贝
+static inline void* localReallocate(void* ptr, size_t oldSize, size_t newSize) {
+    if(newSize == 0) {
+        if(ptr != nullptr) localDeallocate(ptr, oldSize);
+        return nullptr;
+    }
+    if(ptr == nullptr) return localAllocate(newSize);
+    if(oldSize <= MAX_BYTES && newSize <= MAX_BYTES) {
+        if(SizeClass::alignMemory(oldSize) == SizeClass::alignMemory(newSize)) return ptr;
+    }else if(oldSize > MAX_BYTES && newSize > MAX_BYTES) {
+        if(PageCache::ResizeLargeObject(ptr, newSize)) return ptr;
+    }
+    void* newPtr = nullptr;
+    if(newSize > MAX_BYTES && newSize > oldSize) { // 增长中的缓冲区多半还会继续增长，新位置后面预留一半大小的空闲页
+        newPtr = localCountLarge(PageCache::getInstance().AllocLargeObject(newSize, newSize / 2), newSize);
+    }else {
+        newPtr = localAllocate(newSize);
+    }
+    if(newPtr == nullptr) return nullptr; // 与realloc一致，失败时原内存保持不变
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    localDeallocate(ptr, oldSize);
+    return newPtr;
+}
+
+// 分配n * size字节并清零，乘积溢出或为0时返回nullptr，按n * size释放
+// 大对象独占一个Span：Span刚从系统申请或已整体归还给操作系统时页一定为零，不再清零，也不会因此让所有页常驻；
+// 小对象所在的自由链表混有回收的内存块，且每个内存块的头8字节存放过链表指针，总是清零
+static inline void* localCallocate(size_t n, size_t size) {
+    if(size != 0 && n > SIZE_MAX / size) return nullptr;
+    size_t bytes = n * size;
+    if(bytes > MAX_BYTES) return localCountLarge(PageCache::getInstance().AllocZeroedLargeObject(bytes), bytes);
+    void* ptr = localAllocate(bytes);
+    if(ptr != nullptr) memset(ptr, 0, bytes);
+    return ptr;
+}
+
+static inline size_t alignedRequestSize(size_t size, size_t alignment) { // 对齐分配实际向size class申请的大小，alignment不超过一页
+    size = (size + alignment - 1) & ~(alignment - 1);
+    if(size > MAX_BYTES) return size;
+    size_t index = SizeClass::getIndex(size);
+    while(SizeClass::classSize(index) % alignment != 0) index++; // 最后一个size class是MAX_BYTES，一定是alignment的倍数
+    return SizeClass::classSize(index);
+}
+
+// 按alignment(2的幂)对齐分配，alignment不合法时返回nullptr
+// alignment不超过一页时，选一个大小是alignment倍数的size class：Span从页边界开始按对象大小切分，因此每个对象都满足对齐，
+// 不需要多分配（按2的幂间隔划分的策略下，size向上取整为alignment的倍数后所在的size class就满足）；超过一页的对齐由PageCache切出对齐的整数页Span
+static inline void* localAllocateAligned(size_t size, size_t alignment) {
+    if(size == 0 || alignment == 0 || (alignment & (alignment - 1)) != 0) return nullptr;
+    if(alignment > PAGE_SIZE) {
+        return localCountLarge(PageCache::getInstance().AllocAlignedLargeObject(size, alignment), size);
+    }
+    return localAllocate(alignedRequestSize(size, alignment)); // 超过MAX_BYTES时由PageCache分配，整页天然对齐
+}
+
+static inline void localDeallocateAligned(void* ptr, size_t size, size_t alignment) { // size和alignment需与分配时相同；也可以直接调用localDeallocate(ptr)
+    if(ptr == nullptr) return;
+    if(alignment > PAGE_SIZE) {
+        PageCache::FreeLargeObject(ptr);
+        return;
+    }
+    localDeallocate(ptr, alignedRequestSize(size, alignment));
+}
+
+static inline void* localCpuAllocate(size_t size) { // 按CPU缓存分配，缓存总量随核数增长，适合大量线程但大多空闲的场景
+    return CpuCache::getInstance().allocate(size);
+}
+
+static inline void localCpuDeallocate(void* ptr, size_t size) { // 按CPU缓存释放，也可以释放由localAllocate分配的内存，反之亦然
+    CpuCache::getInstance().deallocate(ptr, size);
+}
+
+static inline size_t releaseFreeMemory() { // 在请求高峰之间调用：先归还本线程和各CPU缓存的内存，再把PageCache中所有空闲页归还给操作系统，返回释放的页数
+    if(ptrTLSThreadCache != nullptr) {
+        ptrTLSThreadCache->releaseAll();
+    }
+    CpuCache::getInstance().releaseAll();
+    CentralCache::getInstance().drainTransferCache();
+    return PageCache::releaseFreeMemory();
+}
+
+static inline void startScavenger(uint64_t idleMs, uint64_t intervalMs) { // 后台线程定期归还空闲超过idleMs的页
+    PageCache::startScavenger(idleMs, intervalMs);
+}
+
+static inline void stopScavenger() {
+    PageCache::stopScavenger();
+}
+
+static inline void setHugePageMode(bool enabled) { // 之后向系统申请的内存来自2MB对齐的大页区域，尽量在首次分配前调用
+    PageCache::setHugePageMode(enabled);
+}
+
+// 将当前线程之后的分配固定到某个NUMA节点（节点下标，见getPoolStats的_numaNodes），-1恢复为按所在CPU判断
+// 已绑核的线程可以省去每次查询CPU；也可以配合环境变量MEMORYPOOL_NUMA_NODES在单节点机器上模拟多节点
+static inline void setThreadNumaNode(int node) {
+    NumaTopology::setThreadNode(node);
+}
+
+// 跨线程释放模式：线程释放其他线程从CentralCache取走的小对象时，放入那个线程的无锁队列，由它在下一次缺少该size class时整批取回
+// 适合生产者/消费者流水线：内存回到分配方，而不是堆积在释放方的ThreadCache里再经CentralCache绕回来。关闭后已在队列中的内存块仍会被取回
+static inline void setRemoteFreeMode(bool enabled) {
+    ThreadCache::setRemoteFreeMode(enabled);
+}
+
+// 堆采样：平均每sampleBytes字节的分配采样一次并记录调用栈，0关闭（默认）；也可以通过环境变量MEMORYPOOL_HEAP_SAMPLE在首次分配前开启
+// 不采样的分配只多一次减法和分支；常用的间隔是512KB
+static inline void setHeapProfileInterval(size_t sampleBytes) {
+    ThreadCache::setSampleInterval(sampleBytes);
+    CpuCache::getInstance().resetSampleCountdowns();
+}
+
+// 输出当前存活的采样对象按调用栈汇总的堆profile；pprof为true时输出gperftools格式，可以用pprof <程序> <文件>分析
+static inline void dumpHeapProfile(std::ostream& os, bool pprof = false) {
+    HeapProfiler::dump(os, pprof);
+}
+
+static inline void setThreadCacheBudget(size_t bytes) { // 所有线程的ThreadCache缓存字节数之和的上限，默认THREAD_CACHE_BUDGET
+    ThreadCache::setBudget(bytes);
+}
+
+static inline void getPoolStats(PoolStats& stats) { // 获取整个内存池的统计快照
+    collectPoolStats(stats);
+}
+
+static inline void dumpPoolStats(std::ostream& os, bool json = false) { // 输出统计信息，json为true时输出一行JSON
+    PoolStats stats;
+    collectPoolStats(stats);
+    printPoolStats(os, stats, json);
 }
 
 } // namespace MyMemoryPool
\ No newline at end of file
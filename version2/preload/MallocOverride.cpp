@@ -0,0 +1,226 @@
+// LD_PRELOAD替换库：用内存池实现malloc/free/new/delete等全部标准分配接口
+// 用法：LD_PRELOAD=./libmemorypool_preload.so <程序>
+// 单例在首次调用时构造，不依赖静态初始化顺序；自身不会调用malloc，因此不需要引导用的临时分配器
+// 不属于内存池的指针（例如动态链接器在替换生效前分配的内存）在free时直接忽略
+#include "../include/UseMemoryPool.h"
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <malloc.h>
+#include <pthread.h>
+
+using namespace MyMemoryPool;
+
+#define MIN_ALIGN 16 // malloc保证的对齐，即alignof(max_align_t)
+#define MAX_REQUEST ((size_t)1 << 46) // 超过虚拟地址空间的请求直接失败，也避免按页取整时溢出
+
+static inline size_t roundUp(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static inline bool isPowerOfTwo(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+static inline size_t requestSize(size_t size) { // 小对象的size class只保证8字节对齐，统一向上取整到16字节
+    return size == 0 ? MIN_ALIGN : roundUp(size, MIN_ALIGN);
+}
+
+static inline void* poolMalloc(size_t size) {
+    if(size > MAX_REQUEST) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* ptr = localAllocate(requestSize(size));
+    if(ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+static inline void poolFree(void* ptr) {
+    if(ptr == nullptr) return;
+    SpanList::Span* span = PageCache::getIdOfSpan(ptr);
+    if(span == nullptr) return; // 不是内存池分配的
+    if(span->_objSize == 0) {
+        PageCache::FreeLargeObject(ptr);
+        return;
+    }
+    localDeallocate(ptr, span->_objSize);
+}
+
+static inline void poolSizedFree(void* ptr, size_t size) { // 调用方给出分配时的尺寸，省去一次页表查询
+    if(ptr == nullptr) return;
+    size = requestSize(size);
+    if(size > MAX_BYTES) {
+        PageCache::FreeLargeObject(ptr);
+        return;
+    }
+    localDeallocate(ptr, size);
+}
+
+static void* poolAlignedMalloc(size_t align, size_t size) { // align需为2的幂
+    if(align <= MIN_ALIGN) return poolMalloc(size);
+    if(size > MAX_REQUEST || align > MAX_REQUEST) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* ptr = localAllocateAligned(size == 0 ? 1 : size, align);
+    if(ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+static inline void poolSizedAlignedFree(void* ptr, size_t size, size_t align) { // 与poolAlignedMalloc的分配路径对应
+    if(align <= MIN_ALIGN) {
+        poolSizedFree(ptr, size);
+        return;
+    }
+    localDeallocateAligned(ptr, size == 0 ? 1 : size, align);
+}
+
+static void* poolRealloc(void* ptr, size_t size) {
+    if(ptr == nullptr) return poolMalloc(size);
+    if(size == 0) { // 与glibc一致：释放并返回nullptr
+        poolFree(ptr);
+        return nullptr;
+    }
+    size_t usable = localUsableSize(ptr);
+    if(usable == 0) { // 不是内存池分配的，无法得知原大小
+        errno = ENOMEM;
+        return nullptr;
+    }
+    if(size <= usable && size >= usable / 2) return ptr; // 原内存块够用且浪费不超过一半，原地返回
+    if(size > MAX_REQUEST) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    // usable就是分配时的size class大小或大对象的整页大小，大对象会先尝试原地增大或缩小
+    void* newPtr = localReallocate(ptr, usable, requestSize(size));
+    if(newPtr == nullptr) errno = ENOMEM;
+    return newPtr;
+}
+
+static void* poolNew(size_t size) { // operator new的语义：失败时调用new_handler重试，没有new_handler则抛出bad_alloc
+    void* ptr = poolMalloc(size);
+    while(ptr == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) throw std::bad_alloc();
+        handler();
+        ptr = poolMalloc(size);
+    }
+    return ptr;
+}
+
+static void* poolAlignedNew(size_t size, size_t align) {
+    void* ptr = poolAlignedMalloc(align, size);
+    while(ptr == nullptr) {
+        std::new_handler handler = std::get_new_handler();
+        if(handler == nullptr) throw std::bad_alloc();
+        handler();
+        ptr = poolAlignedMalloc(align, size);
+    }
+    return ptr;
+}
+
+// fork时子进程只保留调用fork的线程，其他线程持有的锁永远不会被释放
+// fork前按固定顺序获取所有锁，之后在父子进程中分别释放，保证子进程中内存池的状态一致
+static void prepareFork() {
+    CpuCache::getInstance().lockAll();
+    CentralCache::getInstance().lockAll();
+    PageCache::lockAll();
+    ThreadCache::lockAll();
+    HeapProfiler::lockAll();
+}
+
+static void releaseFork() {
+    HeapProfiler::unlockAll();
+    ThreadCache::unlockAll();
+    PageCache::unlockAll();
+    CentralCache::getInstance().unlockAll();
+    CpuCache::getInstance().unlockAll();
+}
+
+__attribute__((constructor)) static void registerForkHandlers() {
+    pthread_atfork(prepareFork, releaseFork, releaseFork);
+}
+
+extern "C" {
+
+void* malloc(size_t size) noexcept { return poolMalloc(size); }
+
+void free(void* ptr) noexcept { poolFree(ptr); }
+
+void cfree(void* ptr) noexcept { poolFree(ptr); }
+
+void* calloc(size_t count, size_t size) noexcept {
+    if(size != 0 && count > MAX_REQUEST / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    void* ptr = localCallocate(1, requestSize(count * size)); // 大对象的新页不再清零，避免全部常驻
+    if(ptr == nullptr) errno = ENOMEM;
+    return ptr;
+}
+
+void* realloc(void* ptr, size_t size) noexcept { return poolRealloc(ptr, size); }
+
+void* reallocarray(void* ptr, size_t count, size_t size) noexcept {
+    if(size != 0 && count > MAX_REQUEST / size) {
+        errno = ENOMEM;
+        return nullptr;
+    }
+    return poolRealloc(ptr, count * size);
+}
+
+int posix_memalign(void** memptr, size_t align, size_t size) noexcept {
+    if(!isPowerOfTwo(align) || align % sizeof(void*) != 0) return EINVAL;
+    void* ptr = poolAlignedMalloc(align, size);
+    if(ptr == nullptr) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+void* aligned_alloc(size_t align, size_t size) noexcept {
+    if(!isPowerOfTwo(align)) {
+        errno = EINVAL;
+        return nullptr;
+    }
+    return poolAlignedMalloc(align, size);
+}
+
+void* memalign(size_t align, size_t size) noexcept {
+    if(!isPowerOfTwo(align)) { // 与glibc一致，不是2的幂时向上取整
+        size_t pow = MIN_ALIGN;
+        while(pow < align && pow <= MAX_REQUEST) pow <<= 1;
+        align = pow;
+    }
+    return poolAlignedMalloc(align, size);
+}
+
+void* valloc(size_t size) noexcept { return poolAlignedMalloc(PAGE_SIZE, size); }
+
+void* pvalloc(size_t size) noexcept { return poolAlignedMalloc(PAGE_SIZE, roundUp(size == 0 ? 1 : size, PAGE_SIZE)); }
+
+size_t malloc_usable_size(void* ptr) noexcept { return localUsableSize(ptr); }
+
+} // extern "C"
+
+void* operator new(size_t size) { return poolNew(size); }
+void* operator new[](size_t size) { return poolNew(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return poolMalloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return poolMalloc(size); }
+void* operator new(size_t size, std::align_val_t align) { return poolAlignedNew(size, (size_t)align); }
+void* operator new[](size_t size, std::align_val_t align) { return poolAlignedNew(size, (size_t)align); }
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return poolAlignedMalloc((size_t)align, size); }
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept { return poolAlignedMalloc((size_t)align, size); }
+
+void operator delete(void* ptr) noexcept { poolFree(ptr); }
+void operator delete[](void* ptr) noexcept { poolFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { poolFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { poolFree(ptr); }
+void operator delete(void* ptr, size_t size) noexcept { poolSizedFree(ptr, size); }
+void operator delete[](void* ptr, size_t size) noexcept { poolSizedFree(ptr, size); }
+void operator delete(void* ptr, std::align_val_t) noexcept { poolFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { poolFree(ptr); }
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { poolFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept { poolFree(ptr); }
+void operator delete(void* ptr, size_t size, std::align_val_t align) noexcept { poolSizedAlignedFree(ptr, size, (size_t)align); }
+void operator delete[](void* ptr, size_t size, std::align_val_t align) noexcept { poolSizedAlignedFree(ptr, size, (size_t)align); }
@@ -2,84 +2,189 @@
 
 namespace MyMemoryPool {
 
-CentralCache CentralCache::_instance; // 静态实例化CentralCache单例
+CentralCache::CentralCache() {
+    _numNodes = NumaTopology::getInstance().nodeCount();
+    _nodes[0] = &_localNode;
+    for(size_t node = 1; node < _numNodes; node++){
+        size_t bytes = (sizeof(NodeLists) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+        void* memory = systemAlloc(bytes >> PAGE_SHIFT); // 不经过内存池自身，避免初始化时的递归
+        NumaTopology::getInstance().bindToNode(memory, bytes, node); // 链表头和批次缓冲区也放在所属节点上
+        _nodes[node] = new(memory) NodeLists();
+    }
+}
 
-size_t CentralCache::FetchMemoryForThreadCache(void*& start, void*& end, size_t batchnum, size_t size) {
+size_t CentralCache::FetchMemoryForThreadCache(void*& start, void*& end, size_t batchnum, size_t size, uint32_t owner) {
     assert(size > 0 && size <= MAX_BYTES);
     size_t index = SizeClass::getIndex(size);
+    size_t node = _numNodes == 1 ? 0 : NumaTopology::getInstance().currentNode();
+    NodeLists& lists = *_nodes[node];
+    if(_useTransferCache.load(std::memory_order_relaxed)) {
+        size_t count = lists._transferCache[index].pop(start, end); // 优先取其他线程归还的整批内存块，不需要加锁遍历Span
+        if(count > batchnum) { // 慢开始阶段的线程要的比一整批少，只取batchnum个，其余的放回，不绕过ThreadCache的长度和容量限制
+            void* last = start;
+            for(size_t i = 1; i < batchnum; i++) last = ptrNext(last);
+            void* rest = ptrNext(last);
+            ptrNext(last) = nullptr;
+            ReturnMemoryFromThreadCache(rest, end, count - batchnum, size);
+            end = last;
+            count = batchnum;
+        }
+        if(count > 0) return count;
+    }
     size_t count = 1;
     {
-        std::unique_lock<std::mutex> lock(_spanList[index]._mutexSpan); 
-        SpanList::Span* span = getSpanFromSpanList(_spanList[index], size);
-        assert(span != nullptr && span->_freeList != nullptr);
-        start = span->_freeList;
-        end = start;
-        while(ptrNext(end) != nullptr && count < batchnum) { // 取出要分配的内存块数量，不够就有多少拿多少
-            end = ptrNext(end);
-            count++;
+        SpanBins& bins = lists._bins[index];
+        std::unique_lock<std::mutex> lock(bins._mutex);
+        SpanList::Span* span = getSpanFromBins(bins, size, node);
+        assert(span != nullptr && (span->_freeList != nullptr || span->_unusedStart != nullptr));
+        size_t capacity = (span->_numPages << PAGE_SHIFT) / size;
+        SpanList& before = bins.binOf(span->_useCount, capacity);
+        if(span->_freeList != nullptr) { // 优先复用已归还的内存块
+            start = span->_freeList;
+            end = start;
+            while(ptrNext(end) != nullptr && count < batchnum) { // 取出要分配的内存块数量，不够就有多少拿多少
+                end = ptrNext(end);
+                count++;
+            }
+            span->_freeList = ptrNext(end); // 更新Span的自由链表
+            ptrNext(end) = nullptr; // 断开链表
+        }else {
+            count = carveSpan(span, start, end, batchnum, size);
         }
-        span->_freeList = ptrNext(end); // 更新Span的自由链表
-        ptrNext(end) = nullptr; // 断开链表
         span->_useCount += count; // 更新Span的使用计数
+        SpanList& after = bins.binOf(span->_useCount, capacity);
+        if(&after != &before) { // 占用率跨过了分组边界，移到对应的组；放在链表头，下次取用时继续使用这个Span
+            before.pop(span);
+            after.PushFront(span);
+        }
+        span->_owner.store(owner, std::memory_order_relaxed); // 最近一次取用的线程成为所有者
+        lists._freeObjects[index].fetch_sub(count, std::memory_order_relaxed);
     }
     return count; // 返回分配的内存块数量
 }
 
-SpanList::Span* CentralCache::getSpanFromSpanList(SpanList& spanlist, size_t size) {
+SpanList::Span* CentralCache::getSpanFromBins(SpanBins& bins, size_t size, size_t node) {
     assert(size > 0 && size <= MAX_BYTES);
-    SpanList::Span* span = spanlist.Begin();
-    while(span != spanlist.End()) {
-        if(span->_freeList != nullptr) {
-            return span; // 找到合适的Span
-        }
-        span = span->_next; // 继续遍历
+    // 从最满的组开始取：内存块集中分配在少数Span上，较空的Span得以整体释放回PageCache
+    // 每组中的Span都还有空闲内存块，查找的开销与组数成正比，与Span的个数无关
+    for(size_t bin = OCCUPANCY_BINS; bin > 0; bin--) {
+        if(!bins._partial[bin - 1].isEmpty()) return bins._partial[bin - 1].Begin();
     }
+    if(!bins._empty.isEmpty()) return bins._empty.Begin();
     // 没找到合适的Span，申请新的Span
-    spanlist._mutexSpan.unlock();  // 先解CentralCache的互斥锁，避免其他线程释放内存发生阻塞
-    PageCache::getInstance()._mutexPage.lock(); // 锁住PageCache的全局互斥锁，防止其他线程申请内存
-    SpanList::Span* newSpan = PageCache::getInstance().AllocNewSpanToCentralCache(SizeClass::normPageNum(size));
-    newSpan->_isUse = true; // 标记为正在使用
-    PageCache::getInstance()._mutexPage.unlock();
-    void* start = (void*)(newSpan->_pageID << PAGE_SHIFT);
-    newSpan->_freeList = start; // 将新分配的内存块作为自由链表的头
-    void* end = (void*)((newSpan->_pageID + newSpan->_numPages) << PAGE_SHIFT); // 计算Span的结束地址
-    char* ptr = (char*)start;
-    ptr += size; // 将指针移动到下一个内存块位置
-    void* temp = newSpan->_freeList;
-    while(ptr < end) { // 将剩余的内存块加入自由链表
-        ptrNext(temp) = ptr; // 将当前内存块的下一个指针指向下一个内存块
-        temp = ptrNext(temp); // 更新当前指针
-        ptr += size; // 移动到下一个内存块位置
-    }
-    spanlist._mutexSpan.lock(); // 恢复CentralCache的互斥锁，避免在挂载Span后发生其他线程的竞争
-    spanlist.PushFront(newSpan); // 将新分配的Span挂载到链表头
+    bins._mutex.unlock();  // 先解CentralCache的互斥锁，避免其他线程释放内存发生阻塞
+    // 从本节点的PageCache取Span，内部加锁；返回时已标记为使用中并记录了对象大小，释放时可以通过页表由指针反查
+    // 本节点内存不足时PageCache会从其他节点借用，借来的Span同样属于本节点
+    SpanList::Span* newSpan = PageCache::getInstance(node).AllocNewSpanToCentralCache(SizeClass::normPageNum(size), size);
+    // 不在这里把整个Span切成链表：切分会写每个内存块的头8字节，使所有页立即常驻，改为取用时按批次切分
+    newSpan->_freeList = nullptr;
+    newSpan->_unusedStart = (void*)(newSpan->_pageID << PAGE_SHIFT);
+    size_t objects = (newSpan->_numPages << PAGE_SHIFT) / size; // 末尾不足一个对象的部分舍弃
+    bins._mutex.lock(); // 恢复CentralCache的互斥锁，避免在挂载Span后发生其他线程的竞争
+    bins._empty.PushFront(newSpan); // 新Span还没有分出内存块，挂在空Span组
+    size_t index = SizeClass::getIndex(size);
+    _nodes[node]->_spanCount[index].fetch_add(1, std::memory_order_relaxed);
+    _nodes[node]->_freeObjects[index].fetch_add(objects, std::memory_order_relaxed);
     return newSpan; // 返回新分配的Span
 }
 
+size_t CentralCache::carveSpan(SpanList::Span* span, void*& start, void*& end, size_t batchnum, size_t size) {
+    char* ptr = static_cast<char*>(span->_unusedStart);
+    char* spanEnd = (char*)((span->_pageID + span->_numPages) << PAGE_SHIFT);
+    size_t count = (spanEnd - ptr) / size;
+    if(count > batchnum) count = batchnum;
+    assert(count > 0);
+    start = ptr;
+    for(size_t i = 1; i < count; i++) {
+        ptrNext(ptr) = ptr + size;
+        ptr += size;
+    }
+    ptrNext(ptr) = nullptr;
+    end = ptr;
+    ptr += size;
+    span->_unusedStart = ptr + size <= spanEnd ? ptr : nullptr; // 剩余部分放不下一个对象时视为切分完毕
+    return count;
+}
+
 void CentralCache::FreeMemoryToSpanList(void* start, size_t size) {
     size_t index = SizeClass::getIndex(size);
-    {
-        std::unique_lock<std::mutex> lock(_spanList[index]._mutexSpan);
-        while(start != nullptr){
-            void* next = ptrNext(start);
-            SpanList::Span* span = PageCache::getInstance().getIdOfSpan(start);
-            ptrNext(start) = span->_freeList;
-            span->_freeList = start; // 将释放的内存块插入到Span的自由链表头
-            span->_useCount--; // 更新Span的使用计数
-            if(span->_useCount == 0) { // 如果Span的使用计数为0，说明没有线程在使用它,回收给PageCache
-                _spanList[index].pop(span); // 从SpanList中删除该Span
-                span->_prev = nullptr; // 清空Span的前驱指针
-                span->_next = nullptr; // 清空Span的后继指针
-                span->_freeList = nullptr; // 清空Span的自由链表
-                _spanList[index]._mutexSpan.unlock(); // 解锁SpanList的互斥锁
-                PageCache::getInstance()._mutexPage.lock(); // 锁住PageCache的全局互斥锁，防止其他线程申请内存
-                PageCache::getInstance().FreeSpanToPageCache(span); // 将Span释放到PageCache中
-                PageCache::getInstance()._mutexPage.unlock(); // 解锁PageCache的全局互斥锁
-                _spanList[index]._mutexSpan.lock(); // 恢复SpanList的互斥锁
+    size_t node = nodeOf(start);
+    std::unique_lock<std::mutex> lock(_nodes[node]->_bins[index]._mutex);
+    while(start != nullptr){
+        void* next = ptrNext(start);
+        SpanList::Span* span = PageCache::getIdOfSpan(start);
+        if(span->_node != node) { // 链表中混有其他节点的内存块（线程迁移过节点），换成该节点的桶锁
+            lock.unlock();
+            node = span->_node;
+            lock = std::unique_lock<std::mutex>(_nodes[node]->_bins[index]._mutex);
+        }
+        NodeLists& lists = *_nodes[node];
+        SpanBins& bins = lists._bins[index];
+        size_t capacity = (span->_numPages << PAGE_SHIFT) / size;
+        SpanList& before = bins.binOf(span->_useCount, capacity);
+        ptrNext(start) = span->_freeList;
+        span->_freeList = start; // 将释放的内存块插入到Span的自由链表头
+        span->_useCount--; // 更新Span的使用计数
+        lists._freeObjects[index].fetch_add(1, std::memory_order_relaxed);
+        if(span->_useCount == 0) { // 如果Span的使用计数为0，说明没有线程在使用它,回收给PageCache
+            lists._spanCount[index].fetch_sub(1, std::memory_order_relaxed);
+            lists._freeObjects[index].fetch_sub(capacity, std::memory_order_relaxed);
+            before.pop(span); // 从所在的组中删除该Span
+            span->_prev = nullptr; // 清空Span的前驱指针
+            span->_next = nullptr; // 清空Span的后继指针
+            span->_freeList = nullptr; // 清空Span的自由链表
+            span->_unusedStart = nullptr;
+            lock.unlock(); // 解锁SpanList的互斥锁
+            PageCache& pageCache = PageCache::getInstance(node); // Span归还到所属节点的PageCache
+            pageCache._mutexPage.lock(); // 锁住该节点PageCache的互斥锁，防止其他线程申请内存
+            pageCache.FreeSpanToPageCache(span); // 将Span释放到PageCache中
+            pageCache._mutexPage.unlock();
+            lock.lock(); // 恢复SpanList的互斥锁
+        }else {
+            SpanList& after = bins.binOf(span->_useCount, capacity);
+            if(&after != &before) { // 放在链表尾：同一组中优先取用最近分配过的Span，因释放降到这一组的Span排在后面
+                before.pop(span);
+                after.push(span, after.End());
             }
-            start = next; // 继续处理下一个内存块
+        }
+        start = next; // 继续处理下一个内存块
+    }
+}
+
+void CentralCache::ReturnMemoryFromThreadCache(void* start, void* end, size_t count, size_t size) {
+    size_t index = SizeClass::getIndex(size);
+    TransferCache& transferCache = _nodes[nodeOf(start)]->_transferCache[index]; // 按第一个内存块的节点放入，同一批通常来自同一节点
+    if(_useTransferCache.load(std::memory_order_relaxed) && transferCache.push(start, end, count)) {
+        return; // 整批放入TransferCache，等待同一节点的其他线程取走
+    }
+    FreeMemoryToSpanList(start, size); // TransferCache已满，逐个归还到所属Span
+}
+
+void CentralCache::drainTransferCache() {
+    for(size_t node = 0; node < _numNodes; node++){
+        for(size_t index = 0; index < FREE_LIST_SIZE; index++){
+            void* start = nullptr;
+            void* end = nullptr;
+            while(_nodes[node]->_transferCache[index].pop(start, end) > 0){
+                FreeMemoryToSpanList(start, SizeClass::classSize(index));
+            }
+        }
+    }
+}
+
+void CentralCache::collectStats(PoolStats& stats) {
+    for(size_t node = 0; node < _numNodes; node++){
+        NodeLists& lists = *_nodes[node];
+        for(size_t index = 0; index < FREE_LIST_SIZE; index++){
+            size_t size = SizeClass::classSize(index);
+            SizeClassStats& cls = stats._classes[index];
+            size_t centralBytes = lists._freeObjects[index].load(std::memory_order_relaxed) * size;
+            cls._spans += lists._spanCount[index].load(std::memory_order_relaxed);
+            cls._centralCacheBytes += centralBytes;
+            cls._transferCacheBytes += lists._transferCache[index].cachedObjects() * size;
+            stats._nodes[node]._centralCacheBytes += centralBytes;
         }
     }
 }
 
-} // namespace MyMemoryPool
\ No newline at end of file
+} // namespace MyMemoryPool
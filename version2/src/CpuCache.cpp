@@ -0,0 +1,167 @@
+#include "../include/CpuCache.h"
+#include "../include/CentralCache.h"
+#include "../include/HeapProfiler.h"
+#include <sched.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#define MEMORYPOOL_HAS_RSEQ 1
+#endif
+#endif
+
+namespace MyMemoryPool {
+
+unsigned CpuCache::currentCpu() {
+#if defined(MEMORYPOOL_HAS_RSEQ)
+    if(__rseq_size > 0) { // glibc已为本线程注册rseq，内核在每次调度时更新cpu_id，读取只需一次内存访问
+        const struct rseq* area = reinterpret_cast<const struct rseq*>(
+            static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+        unsigned cpu = __atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED);
+        if((int)cpu >= 0) return cpu; // 未初始化或注册失败时为负值(RSEQ_CPU_ID_*)
+    }
+#endif
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : (unsigned)cpu;
+}
+
+void CpuCache::initSlots() {
+    long cpus = sysconf(_SC_NPROCESSORS_CONF);
+    _numSlots = cpus > 0 ? (size_t)cpus : 1;
+    size_t bytes = _numSlots * sizeof(Slot);
+    void* memory = systemAlloc((bytes + PAGE_SIZE - 1) >> PAGE_SHIFT); // 不经过内存池自身，避免初始化时的递归
+    _slots = static_cast<Slot*>(memory);
+    for(size_t i = 0; i < _numSlots; i++){
+        Slot* slot = new(&_slots[i]) Slot();
+        for(size_t index = 0; index < FREE_LIST_SIZE; index++){
+            slot->_freeList[index] = nullptr;
+            slot->_freeListLength[index] = 0;
+        }
+        slot->_sampleState = 0x9e3779b97f4a7c15ULL * (i + 1) + monotonicNs(); // 每个槽位的间隔序列不同
+        slot->_sampleCountdown.store(HeapProfiler::nextCountdown(slot->_sampleState), std::memory_order_relaxed);
+    }
+    _initialized.store(true, std::memory_order_release);
+}
+
+CpuCache::Slot& CpuCache::getSlot() {
+    std::call_once(_initFlag, &CpuCache::initSlots, this);
+    return _slots[currentCpu() % _numSlots];
+}
+
+void* CpuCache::allocate(size_t size) {
+    if(size == 0) {
+        std::cerr << "Error: Attempt to allocate zero size memory." << std::endl;
+        return nullptr;
+    }
+    if(size > MAX_BYTES){ // 大于最大字节数，直接从PageCache分配整数页的Span，分配后再计入槽位的采样倒计数
+        void* ptr = PageCache::getInstance().AllocLargeObject(size);
+        Slot& slot = getSlot();
+        std::lock_guard<std::mutex> lock(slot._mutex);
+        countAllocation(slot, ptr, size);
+        return ptr;
+    }
+    size_t index = SizeClass::getIndex(size);
+    size_t alignedSize = SizeClass::alignMemory(size);
+    Slot& slot = getSlot();
+    std::lock_guard<std::mutex> lock(slot._mutex);
+    if(slot._freeList[index] == nullptr) { // 槽位为空，从CentralCache批量获取
+        fetchFromCentralCache(slot, index, alignedSize);
+    }
+    void* ptr = slot._freeList[index];
+    slot._freeList[index] = ptrNext(ptr);
+    slot._freeListLength[index]--;
+    countAllocation(slot, ptr, size);
+    return ptr;
+}
+
+inline void CpuCache::countAllocation(Slot& slot, void* ptr, size_t size) {
+    // 采样时持有槽位锁记录调用栈：backtrace分配的内存经由malloc，不会进入CpuCache，不会在同一槽位上重复加锁
+    if(HeapProfiler::charge(slot._sampleCountdown, size)) HeapProfiler::sampleAllocation(slot._sampleCountdown, slot._sampleState, ptr, size);
+}
+
+void CpuCache::deallocate(void* ptr, size_t size) {
+    assert(ptr != nullptr && size > 0);
+    if(size > MAX_BYTES) { // 大于最大字节数，Span直接归还给PageCache
+        return PageCache::FreeLargeObject(ptr);
+    }
+    if(HeapProfiler::mayBeSampled(ptr)) HeapProfiler::recordFree(ptr); // 可以释放ThreadCache分配并被采样的对象
+    size_t index = SizeClass::getIndex(size);
+    size_t alignedSize = SizeClass::alignMemory(size);
+    size_t batchNum = SizeClass::normBatchNum(alignedSize);
+    Slot& slot = getSlot();
+    std::lock_guard<std::mutex> lock(slot._mutex);
+    ptrNext(ptr) = slot._freeList[index]; // 将释放的内存插入回链表头
+    slot._freeList[index] = ptr;
+    slot._freeListLength[index]++;
+    if(slot._freeListLength[index] > 2 * batchNum) { // 每个CPU每个size class最多缓存两批
+        returnToCentralCache(slot, index, alignedSize, batchNum);
+    }
+}
+
+void CpuCache::fetchFromCentralCache(Slot& slot, size_t index, size_t alignedSize) {
+    void* start = nullptr;
+    void* end = nullptr;
+    size_t count = CentralCache::getInstance().FetchMemoryForThreadCache(start, end, SizeClass::normBatchNum(alignedSize), alignedSize);
+    ptrNext(end) = slot._freeList[index];
+    slot._freeList[index] = start;
+    slot._freeListLength[index] += count;
+}
+
+void CpuCache::returnToCentralCache(Slot& slot, size_t index, size_t alignedSize, size_t count) {
+    void* start = slot._freeList[index];
+    void* end = start;
+    for(size_t i = 1; i < count; i++) {
+        end = ptrNext(end);
+    }
+    slot._freeList[index] = ptrNext(end);
+    ptrNext(end) = nullptr;
+    slot._freeListLength[index] -= count;
+    CentralCache::getInstance().ReturnMemoryFromThreadCache(start, end, count, alignedSize);
+}
+
+void CpuCache::releaseAll() {
+    if(!_initialized.load(std::memory_order_acquire)) return; // 从未使用过
+    for(size_t i = 0; i < _numSlots; i++){
+        std::lock_guard<std::mutex> lock(_slots[i]._mutex);
+        for(size_t index = 0; index < FREE_LIST_SIZE; index++){
+            if(_slots[i]._freeList[index] == nullptr) continue;
+            size_t size = PageCache::getIdOfSpan(_slots[i]._freeList[index])->_objSize;
+            CentralCache::getInstance().FreeMemoryToSpanList(_slots[i]._freeList[index], size);
+            _slots[i]._freeList[index] = nullptr;
+            _slots[i]._freeListLength[index] = 0;
+        }
+    }
+}
+
+void CpuCache::lockAll() {
+    if(!_initialized.load(std::memory_order_acquire)) return;
+    for(size_t i = 0; i < _numSlots; i++) _slots[i]._mutex.lock();
+}
+
+void CpuCache::unlockAll() {
+    if(!_initialized.load(std::memory_order_acquire)) return;
+    for(size_t i = _numSlots; i > 0; i--) _slots[i - 1]._mutex.unlock();
+}
+
+void CpuCache::resetSampleCountdowns() {
+    if(!_initialized.load(std::memory_order_acquire)) return; // 创建槽位时按当时的间隔抽取
+    for(size_t i = 0; i < _numSlots; i++){
+        std::lock_guard<std::mutex> lock(_slots[i]._mutex);
+        _slots[i]._sampleCountdown.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t CpuCache::cachedBytes() {
+    if(!_initialized.load(std::memory_order_acquire)) return 0;
+    size_t bytes = 0;
+    for(size_t i = 0; i < _numSlots; i++){
+        std::lock_guard<std::mutex> lock(_slots[i]._mutex);
+        for(size_t index = 0; index < FREE_LIST_SIZE; index++){
+            if(_slots[i]._freeList[index] == nullptr) continue;
+            bytes += _slots[i]._freeListLength[index] * PageCache::getIdOfSpan(_slots[i]._freeList[index])->_objSize;
+        }
+    }
+    return bytes;
+}
+
+} // namespace MyMemoryPool
@@ -0,0 +1,197 @@
+#include "../include/HeapProfiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <execinfo.h>
+
+namespace MyMemoryPool {
+
+std::atomic<size_t> HeapProfiler::_interval{0};
+std::atomic<bool> HeapProfiler::_warmedUp{false};
+std::atomic<size_t> HeapProfiler::_liveSamples{0};
+std::atomic<uint32_t> HeapProfiler::_pageCounts[HEAP_PROFILE_PAGE_BUCKETS];
+std::mutex HeapProfiler::_mutex;
+HeapProfiler::Sample* HeapProfiler::_table[HEAP_PROFILE_TABLE_SIZE];
+DtLenMemoryPool<HeapProfiler::Sample> HeapProfiler::_samplePool;
+static thread_local bool tlsInSample __attribute__((tls_model("initial-exec"))) = false; // 本线程正在记录采样
+
+void HeapProfiler::setSampleInterval(size_t bytes) {
+    if(bytes != 0) warmUp();
+    _interval.store(bytes, std::memory_order_relaxed);
+}
+
+void HeapProfiler::warmUp() {
+    if(_warmedUp.load(std::memory_order_acquire)) return;
+    void* frame = nullptr;
+    tlsInSample = true; // 加载过程中的分配不采样
+    backtrace(&frame, 1);
+    tlsInSample = false;
+    _warmedUp.store(true, std::memory_order_release);
+}
+
+void HeapProfiler::initFromEnv() {
+    const char* env = getenv("MEMORYPOOL_HEAP_SAMPLE"); // getenv和strtoull不分配内存，替换malloc时也可以在这里调用
+    if(env != nullptr) _interval.store(strtoull(env, nullptr, 10), std::memory_order_relaxed);
+}
+
+ptrdiff_t HeapProfiler::nextCountdown(uint64_t& state) {
+    size_t interval = _interval.load(std::memory_order_relaxed);
+    if(interval == 0) return HEAP_PROFILE_DISABLED_BYTES;
+    state ^= state << 13; // xorshift64
+    state ^= state >> 7;
+    state ^= state << 17;
+    double u = ((state >> 11) + 1) * (1.0 / 9007199254740992.0); // (0, 1]上的均匀分布
+    // 几何分布的间隔：每个字节以1/interval的概率被选中，大对象被采样的概率更高，输出时按概率放大
+    return (ptrdiff_t)(-std::log(u) * interval) + 1;
+}
+
+void HeapProfiler::sampleAllocation(std::atomic<ptrdiff_t>& countdown, uint64_t& state, void* ptr, size_t size) {
+    // 先重新抽取间隔：记录调用栈时可能再次进入分配，不会因为倒计数仍为负而重复进入
+    countdown.store(nextCountdown(state), std::memory_order_relaxed);
+    if(ptr == nullptr || tlsInSample || _interval.load(std::memory_order_relaxed) == 0) return;
+    tlsInSample = true;
+    void* stack[HEAP_PROFILE_MAX_DEPTH + 1];
+    int depth = backtrace(stack, HEAP_PROFILE_MAX_DEPTH + 1);
+    Sample* sample = _samplePool.New();
+    tlsInSample = false;
+    if(sample == nullptr) return;
+    sample->_ptr = ptr;
+    sample->_size = size;
+    sample->_depth = depth > 1 ? depth - 1 : 0; // 去掉本函数一层，栈顶是调用它的分配函数
+    for(size_t i = 0; i < sample->_depth; i++) sample->_stack[i] = stack[i + 1];
+    std::lock_guard<std::mutex> lock(_mutex);
+    Sample** link = &_table[tableBucket(ptr)];
+    for(; *link != nullptr; link = &(*link)->_next) {
+        if((*link)->_ptr == ptr) { // 之前的采样对象经由不检查采样的路径释放后地址被复用，旧记录已失效
+            unlinkSample(link);
+            break;
+        }
+    }
+    sample->_next = _table[tableBucket(ptr)];
+    _table[tableBucket(ptr)] = sample;
+    std::atomic<uint32_t>& count = _pageCounts[pageBucket(ptr)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    _liveSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void HeapProfiler::unlinkSample(Sample** link) {
+    Sample* sample = *link;
+    *link = sample->_next;
+    std::atomic<uint32_t>& count = _pageCounts[pageBucket(sample->_ptr)];
+    count.store(count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    _liveSamples.fetch_sub(1, std::memory_order_relaxed);
+    _samplePool.Delete(sample);
+}
+
+void HeapProfiler::recordFree(void* ptr) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for(Sample** link = &_table[tableBucket(ptr)]; *link != nullptr; link = &(*link)->_next) {
+        if((*link)->_ptr == ptr) {
+            unlinkSample(link);
+            return;
+        }
+    }
+}
+
+bool HeapProfiler::sameStack(const Sample& a, const Sample& b) {
+    return a._depth == b._depth && std::equal(a._stack, a._stack + a._depth, b._stack);
+}
+
+struct StackGroup { // 同一调用栈的存活采样
+    size_t _first; // 在按调用栈排序后的快照中的起始下标
+    size_t _count;
+    size_t _bytes; // 采样对象的字节数之和
+    double _estObjects; // 按采样概率放大后的估计值
+    double _estBytes;
+};
+
+void HeapProfiler::dump(std::ostream& os, bool pprof) {
+    size_t interval = _interval.load(std::memory_order_relaxed);
+    // 在锁内把存活采样拷贝到单独映射的内存中再格式化输出：输出时会分配内存，持锁分配可能因为采样或释放再次加锁
+    Sample* samples = nullptr;
+    StackGroup* groups = nullptr;
+    size_t count = 0;
+    size_t mapped = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        count = _liveSamples.load(std::memory_order_relaxed);
+        mapped = (count * (sizeof(Sample) + sizeof(StackGroup)) + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1);
+        if(count > 0) {
+            void* memory = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(memory == MAP_FAILED) return;
+            samples = static_cast<Sample*>(memory);
+            groups = reinterpret_cast<StackGroup*>(samples + count);
+            size_t n = 0;
+            for(size_t i = 0; i < HEAP_PROFILE_TABLE_SIZE; i++) {
+                for(Sample* sample = _table[i]; sample != nullptr; sample = sample->_next) samples[n++] = *sample;
+            }
+        }
+    }
+    std::sort(samples, samples + count, [](const Sample& a, const Sample& b){ // 相同的调用栈排在一起
+        if(a._depth != b._depth) return a._depth < b._depth;
+        return std::lexicographical_compare(a._stack, a._stack + a._depth, b._stack, b._stack + b._depth);
+    });
+    size_t numGroups = 0;
+    size_t totalBytes = 0;
+    double totalEstBytes = 0;
+    for(size_t i = 0; i < count; i++) {
+        if(i == 0 || !sameStack(samples[i], samples[i - 1])) groups[numGroups++] = StackGroup{i, 0, 0, 0, 0};
+        StackGroup& group = groups[numGroups - 1];
+        // 大小为s的对象被采样的概率是1 - exp(-s / interval)，每个采样代表1 / 概率个对象
+        double scale = interval == 0 ? 1.0 : 1.0 / -std::expm1(-(double)samples[i]._size / interval);
+        group._count++;
+        group._bytes += samples[i]._size;
+        group._estObjects += scale;
+        group._estBytes += scale * samples[i]._size;
+        totalBytes += samples[i]._size;
+        totalEstBytes += scale * samples[i]._size;
+    }
+    std::sort(groups, groups + numGroups, [](const StackGroup& a, const StackGroup& b){ return a._estBytes > b._estBytes; });
+
+    char line[64];
+    if(pprof) { // gperftools的文本堆profile，pprof可以直接读取
+        snprintf(line, sizeof(line), "%zu: %zu [%zu: %zu] @ heap_v2/%zu\n", count, totalBytes, count, totalBytes, interval);
+        os << "heap profile: " << line;
+        for(size_t g = 0; g < numGroups; g++) { // 只记录存活对象，已分配(alloc)一栏与存活(inuse)相同
+            const StackGroup& group = groups[g];
+            snprintf(line, sizeof(line), "%zu: %zu [%zu: %zu] @", group._count, group._bytes, group._count, group._bytes);
+            os << line;
+            const Sample& sample = samples[group._first];
+            for(size_t i = 0; i < sample._depth; i++) {
+                snprintf(line, sizeof(line), " %p", sample._stack[i]);
+                os << line;
+            }
+            os << '\n';
+        }
+        os << "\nMAPPED_LIBRARIES:\n"; // pprof据此把地址对应到可执行文件和动态库
+        FILE* maps = fopen("/proc/self/maps", "r");
+        if(maps != nullptr) {
+            char buffer[4096];
+            size_t n = 0;
+            while((n = fread(buffer, 1, sizeof(buffer), maps)) > 0) os.write(buffer, n);
+            fclose(maps);
+        }
+    }else {
+        os << "------------ 堆采样 ------------\n";
+        os << "采样间隔: " << interval << " B, 存活采样: " << count << ", 调用栈: " << numGroups
+           << ", 估计存活: " << (size_t)totalEstBytes / 1024 << " KB\n";
+        for(size_t g = 0; g < numGroups; g++) {
+            const StackGroup& group = groups[g];
+            snprintf(line, sizeof(line), "%10zu KB %10.0f个对象 %6zu个采样\n", (size_t)group._estBytes / 1024, group._estObjects, group._count);
+            os << line;
+            const Sample& sample = samples[group._first];
+            char** symbols = backtrace_symbols(sample._stack, (int)sample._depth); // 符号化在锁外进行，返回的数组由malloc分配
+            for(size_t i = 0; i < sample._depth; i++) {
+                os << "    #" << i << ' ';
+                if(symbols != nullptr) os << symbols[i] << '\n';
+                else os << sample._stack[i] << '\n';
+            }
+            free(symbols);
+        }
+    }
+    os.flush();
+    if(samples != nullptr) munmap(samples, mapped);
+}
+
+} // namespace MyMemoryPool
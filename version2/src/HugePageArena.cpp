@@ -0,0 +1,78 @@
+#include "../include/HugePageArena.h"
+
+namespace MyMemoryPool {
+
+static inline uintptr_t alignUp(uintptr_t value, uintptr_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+static inline uintptr_t alignDown(uintptr_t value, uintptr_t align) {
+    return value & ~(align - 1);
+}
+
+bool HugePageArena::reserve(size_t bytes) {
+    bytes = alignUp(bytes, HUGE_PAGE_SIZE);
+#ifdef MAP_HUGETLB
+    void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(ptr != MAP_FAILED) { // hugetlb映射天然按大页对齐
+        _cursor = static_cast<char*>(ptr);
+        _end = _cursor + bytes;
+        _hugeTlb = true;
+        NumaTopology::getInstance().bindToNode(ptr, bytes, _node);
+        systemMappedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        return true;
+    }
+#endif
+    // 系统没有预留hugetlb页：多映射一个大页的长度，再把首尾多余的部分解除映射得到2MB对齐的区域
+    void* raw = mmap(nullptr, bytes + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(raw == MAP_FAILED) {
+        std::cerr << "Error: Memory allocation failed." << std::endl;
+        return false;
+    }
+    uintptr_t start = alignUp((uintptr_t)raw, HUGE_PAGE_SIZE);
+    size_t head = start - (uintptr_t)raw;
+    size_t tail = HUGE_PAGE_SIZE - head;
+    if(head > 0) munmap(raw, head);
+    if(tail > 0) munmap((void*)(start + bytes), tail);
+#ifdef MADV_HUGEPAGE
+    madvise((void*)start, bytes, MADV_HUGEPAGE); // 透明大页为madvise模式时需要显式开启
+#endif
+    NumaTopology::getInstance().bindToNode((void*)start, bytes, _node);
+    _cursor = (char*)start;
+    _end = _cursor + bytes;
+    _hugeTlb = false;
+    systemMappedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    return true;
+}
+
+void* HugePageArena::allocate(size_t numPages, void*& restStart, size_t& restPages) {
+    size_t bytes = numPages << PAGE_SHIFT;
+    restStart = nullptr;
+    restPages = 0;
+    if((size_t)(_end - _cursor) < bytes) {
+        if(_cursor != _end) { // 剩余部分交给调用者作为空闲Span，不浪费已经预留的大页
+            restStart = _cursor;
+            restPages = (_end - _cursor) >> PAGE_SHIFT;
+        }
+        _cursor = _end = nullptr;
+        if(!reserve(bytes > ARENA_BYTES ? bytes : ARENA_BYTES)) return nullptr;
+    }
+    void* ptr = _cursor;
+    _cursor += bytes;
+    return ptr; // 新映射的页由内核清零，不需要memset
+}
+
+size_t HugePageArena::hugePagesIn(void* start, size_t numPages) {
+    uintptr_t begin = alignUp((uintptr_t)start, HUGE_PAGE_SIZE);
+    uintptr_t end = alignDown((uintptr_t)start + (numPages << PAGE_SHIFT), HUGE_PAGE_SIZE);
+    return end > begin ? (end - begin) >> PAGE_SHIFT : 0;
+}
+
+size_t HugePageArena::releaseHugePages(void* start, size_t numPages) {
+    size_t pages = hugePagesIn(start, numPages);
+    if(pages == 0) return 0;
+    systemRelease((void*)alignUp((uintptr_t)start, HUGE_PAGE_SIZE), pages);
+    return pages;
+}
+
+} // namespace MyMemoryPool
@@ -0,0 +1,77 @@
+#include "../include/MonotonicArena.h"
+
+namespace MyMemoryPool {
+
+void* MonotonicArena::allocateSlow(size_t size, size_t alignment) {
+    if(size > (SIZE_MAX >> 1)) return nullptr;
+    size_t numPages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT; // Span从页边界开始，alignment不超过一页，起点一定满足对齐
+    bool dedicated = numPages > _nextPages / 4; // 较大的请求单独取一个Span，不丢弃当前Span剩余的空间，也不打断翻倍
+    if(!dedicated) numPages = _nextPages;
+    // 与CentralCache相同的取Span接口，对象大小为0表示整个Span作为一个大对象，不会被切分
+    SpanList::Span* span = PageCache::getInstance().AllocNewSpanToCentralCache(numPages, 0);
+    if(span == nullptr) return nullptr;
+    span->_next = _spans; // 使用中的大对象Span不在任何链表上，_next留给区域串成栈
+    _spans = span;
+    _spanBytes += span->_numPages << PAGE_SHIFT;
+    char* start = spanStart(span);
+    if(dedicated) return start;
+    _current = span;
+    _ptr = start + size;
+    _end = spanEnd(span);
+    if(_nextPages < MAX_PAGES) _nextPages = std::min(_nextPages * 2, (size_t)MAX_PAGES);
+    return start;
+}
+
+void MonotonicArena::freeSpansAbove(SpanList::Span* top) {
+    if(_spans == top) return;
+    SpanList::Span* head = _spans;
+    SpanList::Span* last = head;
+    for(;;){
+        _spanBytes -= last->_numPages << PAGE_SHIFT;
+        if(last->_next == top) break;
+        last = last->_next;
+    }
+    last->_next = nullptr;
+    _spans = top;
+    PageCache::FreeLargeSpans(head);
+}
+
+void MonotonicArena::rewind(const Mark& mark) {
+    freeSpansAbove(mark._top);
+    _current = mark._current;
+    _ptr = mark._ptr;
+    _end = _current != nullptr ? spanEnd(_current) : nullptr;
+}
+
+void MonotonicArena::reset() {
+    if(_current == nullptr){ // 只有单独分配的大块，全部归还
+        release();
+        return;
+    }
+    SpanList::Span* head = nullptr; // 除_current外的Span重新串成一条链一起归还
+    SpanList::Span* span = _spans;
+    while(span != nullptr){
+        SpanList::Span* next = span->_next;
+        if(span != _current){
+            span->_next = head;
+            head = span;
+        }
+        span = next;
+    }
+    _current->_next = nullptr;
+    _spans = _current;
+    _spanBytes = _current->_numPages << PAGE_SHIFT;
+    _ptr = spanStart(_current);
+    _end = spanEnd(_current);
+    if(head != nullptr) PageCache::FreeLargeSpans(head);
+}
+
+void MonotonicArena::release() {
+    freeSpansAbove(nullptr);
+    _current = nullptr;
+    _ptr = nullptr;
+    _end = nullptr;
+    _nextPages = MONOTONIC_ARENA_MIN_PAGES;
+}
+
+} // namespace MyMemoryPool
@@ -0,0 +1,113 @@
+#include "../include/NumaTopology.h"
+#include "../include/CpuCache.h"
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<linux/mempolicy.h>)
+#include <linux/mempolicy.h>
+#endif
+#endif
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+namespace MyMemoryPool {
+
+static thread_local int tlsNumaNode __attribute__((tls_model("initial-exec"))) = -1; // setThreadNode设置的节点下标
+
+static bool readSmallFile(const char* path, char* buf, size_t size) { // 读取sysfs中的短文本，以'\0'结尾
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if(n <= 0) return false;
+    buf[n] = '\0';
+    return true;
+}
+
+template<typename F>
+static void parseList(const char* str, F fn) { // 解析"0-3,8,10-11"格式的列表，对其中每个数调用fn
+    while(*str >= '0' && *str <= '9') {
+        long first = strtol(str, const_cast<char**>(&str), 10);
+        long last = first;
+        if(*str == '-') last = strtol(str + 1, const_cast<char**>(&str), 10);
+        for(long i = first; i <= last; i++) fn(i);
+        if(*str != ',') break;
+        str++;
+    }
+}
+
+static char* appendNumber(char* dst, long value) { // 不用snprintf拼接路径，避免可能的内存分配
+    char digits[24];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while(value > 0);
+    while(n > 0) *dst++ = digits[--n];
+    return dst;
+}
+
+NumaTopology::NumaTopology() {
+    if(!readTopology()) { // 没有拓扑信息，按单节点处理
+        _numNodes = 1;
+        _nodeIds[0] = 0;
+        for(size_t cpu = 0; cpu < MAX_NUMA_CPUS; cpu++) _cpuToNode[cpu] = 0;
+    }
+    const char* env = getenv("MEMORYPOOL_NUMA_NODES");
+    long simulated = env != nullptr ? strtol(env, nullptr, 10) : 0;
+    if(simulated > (long)_numNodes) {
+        _numNodes = simulated > MAX_NUMA_NODES ? MAX_NUMA_NODES : (size_t)simulated;
+        _simulated = true;
+        for(size_t node = 0; node < _numNodes; node++) _nodeIds[node] = (int)node;
+        for(size_t cpu = 0; cpu < MAX_NUMA_CPUS; cpu++) _cpuToNode[cpu] = (uint8_t)(cpu % _numNodes);
+    }
+}
+
+bool NumaTopology::readTopology() {
+    char buf[4096];
+    if(!readSmallFile("/sys/devices/system/node/online", buf, sizeof(buf))) return false;
+    size_t count = 0;
+    parseList(buf, [&](long id) {
+        if(count < MAX_NUMA_NODES) _nodeIds[count] = (int)id;
+        count++;
+    });
+    if(count == 0) return false;
+    _numNodes = count < MAX_NUMA_NODES ? count : MAX_NUMA_NODES; // 超出的节点不单独建PageCache，按下标取模并入已有节点
+    char cpuList[4096];
+    size_t index = 0;
+    parseList(buf, [&](long id) {
+        uint8_t node = (uint8_t)(index++ % MAX_NUMA_NODES);
+        char path[64] = "/sys/devices/system/node/node";
+        strcpy(appendNumber(path + strlen(path), (int)id), "/cpulist");
+        if(!readSmallFile(path, cpuList, sizeof(cpuList))) return; // 没有CPU的节点（例如纯内存节点）
+        parseList(cpuList, [&](long cpu) {
+            if(cpu >= 0 && cpu < MAX_NUMA_CPUS) _cpuToNode[cpu] = node;
+        });
+    });
+    return true;
+}
+
+size_t NumaTopology::currentNode() const {
+    if(tlsNumaNode >= 0) return (size_t)tlsNumaNode % _numNodes;
+    if(_numNodes == 1) return 0;
+    return nodeOfCpu(CpuCache::currentCpu()); // rseq区域中的cpu_id，只需一次内存访问
+}
+
+void NumaTopology::setThreadNode(int node) {
+    tlsNumaNode = node;
+}
+
+bool NumaTopology::bindToNode(void* ptr, size_t bytes, size_t node) const {
+    if(_numNodes == 1 || _simulated) return false;
+    int id = _nodeIds[node];
+    unsigned long mask[MAX_NUMA_CPUS / (8 * sizeof(unsigned long))] = {0}; // 节点号一般远小于CPU数，同样按1024位处理
+    if(id < 0 || (size_t)id >= sizeof(mask) * 8) return false;
+    mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+    // 直接使用系统调用，不依赖libnuma；maxnode按内核的约定传入位数+1
+    return syscall(SYS_mbind, ptr, bytes, MPOL_PREFERRED, mask, sizeof(mask) * 8 + 1, 0) == 0;
+}
+
+} // namespace MyMemoryPool
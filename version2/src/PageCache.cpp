@@ -1,74 +1,435 @@
 #include "../include/PageCache.h"
+#include "../include/HeapProfiler.h"
 
 namespace MyMemoryPool {
-    PageCache PageCache::_instance; // 静态实例化PageCache单例
-
-    SpanList::Span* PageCache::AllocNewSpanToCentralCache(size_t numPages){
-        assert(numPages > 0 && numPages <= MAX_PAGES);
-        if(!_spanList[numPages - 1].isEmpty()) return _spanList[numPages - 1].PopFront(); // 有对应页数的Span直接返回
-        for(size_t i = numPages; i < MAX_PAGES; i++){ // 依次向后查找页数更大的Span
-            if(!_spanList[i].isEmpty()){ // 找到了返回numPages对应大小的Span,剩余的页数挂载到相应的链表前面
-                SpanList::Span* temp = _spanList[i].PopFront();
-                SpanList::Span* span = _spanPool.New(); // 从定长内存池中分配一个Span
-                span->_pageID = temp->_pageID; // 继承原Span的页ID
-                span->_numPages = numPages; // 设置新的Span页数
-                temp->_pageID += numPages; // 更新剩余Span的页ID,相当于右移，因为拿走的是左边的页
-                temp->_numPages -= numPages; // 更新剩余Span的页数
-                _spanList[temp->_numPages - 1].PushFront(temp); // 将切分后得到的Span挂载到对应的链表上
-                _spanMap[temp->_pageID] = temp; // 更新首页号
-                _spanMap[temp->_pageID + temp->_numPages - 1] = temp; // 更新末尾页号
-                for(PAGE_ID i = 0; i < span->_numPages; i++){
-                    _spanMap[span->_pageID + i] = span; // 更新每一页对应的页号
-                }
-                return span; // 返回numPages对应的Span
-            }
+    std::mutex& PageCache::pageMapMutex() {
+        alignas(std::mutex) static char storage[sizeof(std::mutex)];
+        static std::mutex* instance = new(storage) std::mutex();
+        return *instance;
+    }
+
+    SpanList::Span* PageCache::newSpan() {
+        SpanList::Span* span = _spanPool.New();
+        span->_node = (uint8_t)_node;
+        return span;
+    }
+
+    SpanList::Span* PageCache::AllocNewSpanToCentralCache(size_t numPages, size_t objSize){
+        return allocInUseSpan(numPages, 0, objSize);
+    }
+
+    SpanList::Span* PageCache::allocInUseSpan(size_t numPages, size_t slackPages, size_t objSize) {
+        SpanList::Span* span = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(_mutexPage);
+            span = allocSpan(numPages, slackPages, true);
+            if(span != nullptr) markInUse(span, objSize);
         }
-        // 没找到，直接向系统申请一个最大页数的Span
-        SpanList::Span* newSpan = _spanPool.New();
-        void* ptr = systemAlloc(MAX_PAGES);
-        newSpan->_pageID = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
-        newSpan->_numPages = MAX_PAGES;
-        _spanList[MAX_PAGES - 1].PushFront(newSpan); // 将新Span挂载到对应的链表上
-        return AllocNewSpanToCentralCache(numPages); // 递归调用，返回对应页数的Span,对刚分配的大块内存进行切分
+        if(span == nullptr) span = allocFromOtherNodes(numPages, objSize); // 本节点无法再向系统申请，借用其他节点的空闲页
+        return span;
     }
 
-    SpanList::Span* PageCache::getIdOfSpan(void* ptr) {
-        PAGE_ID id = ((PAGE_ID)ptr >> PAGE_SHIFT); 
-        std::unique_lock<std::mutex> lock(_mutexPage);
-        auto it = _spanMap.find(id);
-        if(it != _spanMap.end()) {
-            return it->second;
+    SpanList::Span* PageCache::allocFromOtherNodes(size_t numPages, size_t objSize) {
+        size_t count = nodeCount();
+        for(size_t i = 1; i < count; i++){
+            PageCache& other = getInstance((_node + i) % count);
+            std::unique_lock<std::mutex> first(other._node < _node ? other._mutexPage : _mutexPage); // 按节点下标顺序加锁，避免互相借用时死锁
+            std::unique_lock<std::mutex> second(other._node < _node ? _mutexPage : other._mutexPage);
+            SpanList::Span* span = other.allocSpan(numPages, 0, false);
+            if(span == nullptr) continue;
+            // 借来的Span改为属于本节点，释放后回到本节点；页表项已指向span，两个节点的锁都持有，其他线程看不到中间状态
+            span->_node = (uint8_t)_node;
+            markInUse(span, objSize);
+            _borrowedSpans++;
+            return span;
         }
         return nullptr;
     }
 
-    void PageCache::FreeSpanToPageCache(SpanList::Span* span) {
+    void PageCache::markInUse(SpanList::Span* span, size_t objSize) {
+        span->_isUse = true;
+        span->_objSize = objSize; // 为0时整个Span作为一个大对象，不切分
+        if(objSize == 0){
+            _largeAllocs++;
+            _largeBytes += span->_numPages << PAGE_SHIFT;
+        }
+    }
+
+    SpanList::Span* PageCache::allocSpan(size_t numPages, size_t slackPages, bool allowSystem){
+        assert(numPages > 0);
+        SpanList::Span* span = nullptr;
+        if(slackPages > 0){ // 优先找一个更大的空闲Span，切走左边后剩下的页紧跟在后面，之后可以原地增长
+            span = findFreeSpan(numPages + slackPages);
+        }
+        if(span == nullptr) span = findFreeSpan(numPages);
+        if(span == nullptr){ // 没找到，直接向系统申请
+            if(!allowSystem) return nullptr;
+            span = allocSystemSpan(numPages + slackPages);
+            if(span == nullptr) return nullptr;
+        }else{
+            removeFreeSpan(span);
+        }
+        if(span->_numPages > numPages){ // 切分出numPages对应大小的Span,剩余的页数挂载到相应的链表前面
+            SpanList::Span* temp = span;
+            span = newSpan(); // 从定长内存池中分配一个Span
+            span->_pageID = temp->_pageID; // 继承原Span的页ID
+            span->_numPages = numPages; // 设置新的Span页数
+            span->_isZero = temp->_isZero; // 两边都继承原Span是否为零
+            temp->_pageID += numPages; // 更新剩余Span的页ID,相当于右移，因为拿走的是左边的页
+            temp->_numPages -= numPages; // 更新剩余Span的页数
+            // 已归还的页数按先左后右的顺序分摊：整体归还过的Span切分后两边仍是完全归还的状态
+            temp->_releasedPages -= std::min(numPages, temp->_releasedPages);
+            pushFreeSpan(temp); // 将切分后得到的Span挂载到对应的链表上
+        }
+        span->_releasedPages = 0; // 交出去的页会被使用者访问，由缺页重新建立映射，视为常驻
+        for(PAGE_ID i = 0; i < span->_numPages; i++){
+            pageMap().set(span->_pageID + i, span); // 更新每一页对应的页号，按对象地址查找Span时需要
+        }
+        return span; // 返回numPages对应的Span
+    }
+
+    SpanList::Span* PageCache::allocSystemSpan(size_t numPages) {
+        size_t allocPages = numPages > MAX_PAGES ? numPages : MAX_PAGES; // 至少申请一个最大页数的Span，多余的部分留作后续切分
+        void* ptr = nullptr;
+        if(_hugePages){
+            void* restStart = nullptr;
+            size_t restPages = 0;
+            ptr = _arena.allocate(allocPages, restStart, restPages);
+            if(restPages > 0){ // 上一块区域剩下的页作为空闲Span，可以与之前切出的相邻Span合并
+                SpanList::Span* rest = newSpan();
+                rest->_pageID = (PAGE_ID)((uintptr_t)restStart >> PAGE_SHIFT);
+                rest->_numPages = restPages;
+                ensurePages(rest->_pageID, rest->_numPages);
+                FreeSpanToPageCache(rest, true);
+            }
+        }else{
+            ptr = systemAlloc(allocPages);
+            // 新映射的页还没有被访问过，在缺页之前设置内存策略，物理页就会从本节点分配（单节点时不做任何事）
+            if(ptr != nullptr) NumaTopology::getInstance().bindToNode(ptr, allocPages << PAGE_SHIFT, _node);
+        }
+        if(ptr == nullptr) return nullptr;
+        SpanList::Span* span = newSpan();
+        span->_pageID = (PAGE_ID)((uintptr_t)ptr >> PAGE_SHIFT);
+        span->_numPages = allocPages;
+        span->_isZero = true; // 新映射的页由内核清零
+        ensurePages(span->_pageID, span->_numPages); // 新内存的页表节点在这里一次性建好
+        _systemPages += allocPages;
+        return span;
+    }
+
+    void PageCache::ensurePages(PAGE_ID start, size_t numPages) {
+        std::lock_guard<std::mutex> lock(pageMapMutex()); // 不同节点的内存可能落在同一个叶子节点里
+        pageMap().ensure(start, numPages);
+    }
+
+    void PageCache::FreeSpanToPageCache(SpanList::Span* span, bool isZero) {
+        assert(span->_node == _node);
+        span->_releasedPages = 0; // 刚用完的页都是常驻的
+        span->_isZero = isZero;
         while(1){ // 向前合并
             PAGE_ID prevID = span->_pageID - 1;
-            auto it = _spanMap.find(prevID);
-            if(it == _spanMap.end()) break; // 没有前一个页，直接退出向前合并
-            if(it->second->_isUse) break; // 前一个页所属的Span正在使用，不能合并
-            if(it->second->_numPages + span->_numPages > MAX_PAGES) break; // 合并后页数超过最大页数，不能合并
-            span->_pageID = it->second->_pageID; // 更新当前Span的页ID
-            span->_numPages += it->second->_numPages; // 更新当前Span的页数
-            _spanList[it->second->_numPages - 1].pop(it->second); // 从对应的链表中删除前一个Span
-            // _spanPool.Delete(it->second); // 归还节点，防止内存泄漏
+            SpanList::Span* prev = pageMap().get(prevID);
+            if(prev == nullptr) break; // 没有前一个页，直接退出向前合并
+            if(prev->_node != _node) break; // 属于其他节点，不能合并，也不能在没有该节点锁的情况下读取其他字段
+            if(prev->_isUse) break; // 前一个页所属的Span正在使用，不能合并
+            span->_pageID = prev->_pageID; // 更新当前Span的页ID
+            span->_numPages += prev->_numPages; // 更新当前Span的页数
+            span->_releasedPages += prev->_releasedPages; // 合并后继承相邻Span中已归还的页数
+            span->_isZero = span->_isZero && prev->_isZero; // 只有两边都为零时合并后才为零
+            removeFreeSpan(prev); // 从对应的链表中删除前一个Span
+            _spanPool.Delete(prev); // 归还节点，防止内存泄漏
         }
         while(1){ // 向后合并
             PAGE_ID nextID = span->_pageID + span->_numPages;
-            auto it = _spanMap.find(nextID);
-            if(it == _spanMap.end()) break; // 没有后一个页，直接退出向后合并
-            if(it->second->_isUse) break; // 后一个页所属的Span正在使用，不能合并
-            if(it->second->_numPages + span->_numPages > MAX_PAGES) break; // 合并后页数超过最大页数，不能合并
-            span->_numPages += it->second->_numPages; // 更新当前Span的页数
-            _spanList[it->second->_numPages - 1].pop(it->second); // 从对应的链表中删除后一个Span
-            // _spanPool.Delete(it->second); // 归还节点，防止内存泄漏
-        }
-        // 将合并后的Span释放到PageCache中
-        _spanList[span->_numPages - 1].PushFront(span); // 将合并后的Span挂载到对应的哈希桶上
+            SpanList::Span* next = pageMap().get(nextID);
+            if(next == nullptr) break; // 没有后一个页，直接退出向后合并
+            if(next->_node != _node) break;
+            if(next->_isUse) break; // 后一个页所属的Span正在使用，不能合并
+            span->_numPages += next->_numPages; // 更新当前Span的页数
+            span->_releasedPages += next->_releasedPages;
+            span->_isZero = span->_isZero && next->_isZero;
+            removeFreeSpan(next); // 从对应的链表中删除后一个Span
+            _spanPool.Delete(next); // 归还节点，防止内存泄漏
+        }
+        // 将合并后的Span释放到PageCache中，合并后的页数不再受MAX_PAGES限制
         span->_isUse = false; // 标记Span为未使用
-        _spanMap[span->_pageID] = span; // 更新首页号
-        _spanMap[span->_pageID + span->_numPages - 1] = span; // 更新末尾页号
+        span->_freeTime = monotonicNs(); // 重新计算空闲时长
+        pushFreeSpan(span); // 将合并后的Span挂载到对应的哈希桶上
+    }
+
+    void* PageCache::AllocLargeObject(size_t size, size_t slackSize) {
+        size_t numPages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT; // 向上取整到整数页
+        size_t slackPages = (slackSize + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        SpanList::Span* span = allocInUseSpan(numPages, slackPages, 0);
+        if(span == nullptr) return nullptr;
+        return (void*)(span->_pageID << PAGE_SHIFT);
+    }
+
+    void* PageCache::AllocZeroedLargeObject(size_t size) {
+        size_t numPages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        SpanList::Span* span = allocInUseSpan(numPages, 0, 0);
+        if(span == nullptr) return nullptr;
+        void* ptr = (void*)(span->_pageID << PAGE_SHIFT);
+        if(!span->_isZero) memset(ptr, 0, size); // 回收的页才需要清零，在锁外进行；新页保持未访问，按需缺页
+        return ptr;
+    }
+
+    void* PageCache::AllocAlignedLargeObject(size_t size, size_t alignment) {
+        assert(alignment > PAGE_SIZE && (alignment & (alignment - 1)) == 0);
+        size_t numPages = (size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        size_t alignPages = alignment >> PAGE_SHIFT;
+        // 多取alignPages - 1页保证其中一定有对齐的起点，与其他大对象一样在本节点无法分配时向其他节点借用
+        SpanList::Span* span = allocInUseSpan(numPages + alignPages - 1, 0, 0);
+        if(span == nullptr) return nullptr;
+        // 再把对齐起点之前和对象末尾之后的页切下来归还；Span已标记为使用中，切下的首尾Span归还时不会与它合并
+        // 借来的Span此时也已属于本节点，切下的页同样归还到本节点
+        std::unique_lock<std::mutex> lock(_mutexPage);
+        PAGE_ID alignedID = (span->_pageID + alignPages - 1) & ~(PAGE_ID)(alignPages - 1);
+        size_t headPages = alignedID - span->_pageID;
+        size_t tailPages = span->_numPages - headPages - numPages;
+        if(headPages > 0){
+            SpanList::Span* head = newSpan();
+            head->_pageID = span->_pageID;
+            head->_numPages = headPages;
+            span->_pageID = alignedID;
+            span->_numPages -= headPages;
+            FreeSpanToPageCache(head, span->_isZero); // 首尾Span中间页的页表项仍指向span，空闲Span只按首尾页查找，重新分配时会整体覆盖
+        }
+        if(tailPages > 0){
+            SpanList::Span* tail = newSpan();
+            tail->_pageID = span->_pageID + numPages;
+            tail->_numPages = tailPages;
+            span->_numPages = numPages;
+            FreeSpanToPageCache(tail, span->_isZero);
+        }
+        _largeBytes -= (headPages + tailPages) << PAGE_SHIFT; // markInUse按切分前的页数计入
+        return (void*)(span->_pageID << PAGE_SHIFT);
+    }
+
+    bool PageCache::ResizeLargeObject(void* ptr, size_t newSize) {
+        SpanList::Span* span = getIdOfSpan(ptr);
+        assert(span != nullptr && span->_isUse && span->_objSize == 0);
+        return getInstance(span->_node).resizeLargeObject(span, newSize); // 正在使用的Span所属节点不会改变
+    }
+
+    bool PageCache::resizeLargeObject(SpanList::Span* span, size_t newSize) {
+        size_t newPages = (newSize + PAGE_SIZE - 1) >> PAGE_SHIFT;
+        std::unique_lock<std::mutex> lock(_mutexPage);
+        size_t oldPages = span->_numPages;
+        if(newPages < oldPages){ // 缩小：尾部的页切成新的Span归还，可以与后面的空闲Span合并
+            SpanList::Span* tail = newSpan();
+            tail->_pageID = span->_pageID + newPages;
+            tail->_numPages = oldPages - newPages;
+            span->_numPages = newPages;
+            FreeSpanToPageCache(tail);
+        }else if(newPages > oldPages){ // 增大：只能使用紧随其后的空闲Span
+            size_t needPages = newPages - oldPages;
+            SpanList::Span* next = pageMap().get(span->_pageID + oldPages);
+            if(next == nullptr || next->_node != _node || next->_isUse || next->_pageID != span->_pageID + oldPages) return false;
+            if(next->_numPages < needPages) return false;
+            removeFreeSpan(next);
+            if(next->_numPages > needPages){ // 与切分时相同，拿走左边的页，剩余部分继续挂在空闲链表上
+                next->_pageID += needPages;
+                next->_numPages -= needPages;
+                next->_releasedPages -= std::min(needPages, next->_releasedPages);
+                pushFreeSpan(next);
+            }else{
+                _spanPool.Delete(next);
+            }
+            span->_numPages = newPages;
+            for(PAGE_ID i = oldPages; i < newPages; i++){
+                pageMap().set(span->_pageID + i, span);
+            }
+        }
+        _largeBytes -= oldPages << PAGE_SHIFT;
+        _largeBytes += newPages << PAGE_SHIFT;
+        return true;
+    }
+
+    void PageCache::FreeLargeObject(void* ptr) {
+        if(HeapProfiler::mayBeSampled(ptr)) HeapProfiler::recordFree(ptr); // 大对象的所有释放路径都经过这里
+        SpanList::Span* span = getIdOfSpan(ptr);
+        assert(span != nullptr && span->_isUse && span->_objSize == 0);
+        PageCache& owner = getInstance(span->_node); // 归还到所属节点，可能不是当前线程所在的节点
+        std::unique_lock<std::mutex> lock(owner._mutexPage);
+        owner._largeFrees++;
+        owner._largeBytes -= span->_numPages << PAGE_SHIFT;
+        owner.FreeSpanToPageCache(span);
+    }
+
+    void PageCache::FreeLargeSpans(SpanList::Span* head) {
+        while(head != nullptr){
+            PageCache& owner = getInstance(head->_node);
+            std::unique_lock<std::mutex> lock(owner._mutexPage);
+            while(head != nullptr && head->_node == owner._node){ // 链表上的Span都在使用中，不会被合并，先取出_next再归还
+                SpanList::Span* next = head->_next;
+                assert(head->_isUse && head->_objSize == 0);
+                owner._largeFrees++;
+                owner._largeBytes -= head->_numPages << PAGE_SHIFT;
+                owner.FreeSpanToPageCache(head);
+                head = next;
+            }
+        }
+    }
+
+    SpanList::Span* PageCache::findFreeSpan(size_t numPages) {
+        for(size_t i = numPages - 1; i < MAX_PAGES; i++){ // 依次向后查找页数更大的Span
+            if(!_spanList[i].isEmpty()) return _spanList[i].Begin();
+        }
+        SpanList::Span* best = nullptr;
+        for(SpanList::Span* it = _largeSpanList.Begin(); it != _largeSpanList.End(); it = it->_next){
+            if(it->_numPages >= numPages && (best == nullptr || it->_numPages < best->_numPages)){
+                best = it;
+                if(best->_numPages == numPages) break; // 恰好合适，不必再找
+            }
+        }
+        return best;
+    }
+
+    void PageCache::pushFreeSpan(SpanList::Span* span) {
+        if(span->_numPages <= MAX_PAGES){
+            _spanList[span->_numPages - 1].PushFront(span);
+        }else{
+            _largeSpanList.PushFront(span);
+        }
+        pageMap().set(span->_pageID, span); // 空闲Span只需登记首尾页号，供相邻Span合并时查找
+        pageMap().set(span->_pageID + span->_numPages - 1, span);
+    }
+
+    void PageCache::removeFreeSpan(SpanList::Span* span) {
+        if(span->_numPages <= MAX_PAGES){
+            _spanList[span->_numPages - 1].pop(span);
+        }else{
+            _largeSpanList.pop(span);
+        }
+    }
+
+    size_t PageCache::releaseIdleSpans(uint64_t idleNs) {
+        std::unique_lock<std::mutex> lock(_mutexPage);
+        uint64_t now = monotonicNs();
+        size_t released = 0;
+        for(size_t i = 0; i < MAX_PAGES; i++){
+            released += releaseSpanList(_spanList[i], now, idleNs);
+        }
+        released += releaseSpanList(_largeSpanList, now, idleNs);
+        return released;
+    }
+
+    size_t PageCache::releaseFreeMemory() {
+        size_t released = 0;
+        for(size_t node = 0; node < nodeCount(); node++){
+            released += getInstance(node).releaseIdleSpans(0);
+        }
+        return released;
+    }
+
+    size_t PageCache::releaseSpanList(SpanList& list, uint64_t now, uint64_t idleNs) {
+        size_t released = 0;
+        for(SpanList::Span* span = list.Begin(); span != list.End(); span = span->_next){
+            void* start = (void*)(span->_pageID << PAGE_SHIFT);
+            // 大页模式下只归还完整覆盖的2MB大页，不足一个大页的部分保持常驻，避免把大页拆成普通页
+            size_t target = _hugePages ? HugePageArena::hugePagesIn(start, span->_numPages) : span->_numPages;
+            if(span->_releasedPages >= target) continue; // 能归还的已经全部归还
+            if(now - span->_freeTime < idleNs) continue; // 空闲时间不够长，可能很快会被再次使用
+            // 整个Span一次madvise，映射保留，Span仍留在空闲链表中可以直接复用
+            if(_hugePages) HugePageArena::releaseHugePages(start, span->_numPages);
+            else systemRelease(start, span->_numPages);
+            released += target - span->_releasedPages;
+            span->_releasedPages = target;
+            if(target == span->_numPages) span->_isZero = true; // MADV_DONTNEED之后再次访问得到清零的页
+        }
+        return released;
+    }
+
+    void PageCache::setHugePageMode(bool enabled) {
+        for(size_t node = 0; node < nodeCount(); node++){
+            PageCache& cache = getInstance(node);
+            std::unique_lock<std::mutex> lock(cache._mutexPage);
+            cache._hugePages = enabled;
+        }
+    }
+
+    bool PageCache::hugePageMode() {
+        PageCache& cache = getInstance(0);
+        std::unique_lock<std::mutex> lock(cache._mutexPage);
+        return cache._hugePages;
+    }
+
+    void PageCache::lockAll() { // 先按节点下标获取所有_mutexPage，与借用时的加锁顺序一致，再获取定长内存池和页表的锁
+        for(size_t node = 0; node < nodeCount(); node++) getInstance(node)._mutexPage.lock();
+        for(size_t node = 0; node < nodeCount(); node++) getInstance(node)._spanPool.lock();
+        pageMapMutex().lock();
+    }
+
+    void PageCache::unlockAll() {
+        pageMapMutex().unlock();
+        for(size_t node = nodeCount(); node > 0; node--) getInstance(node - 1)._spanPool.unlock();
+        for(size_t node = nodeCount(); node > 0; node--) getInstance(node - 1)._mutexPage.unlock();
+    }
+
+    void PageCache::collectStats(PoolStats& stats) {
+        stats._numaNodes = nodeCount();
+        for(size_t node = 0; node < nodeCount(); node++){
+            getInstance(node).collectNodeStats(stats);
+        }
+    }
+
+    void PageCache::collectNodeStats(PoolStats& stats) {
+        std::unique_lock<std::mutex> lock(_mutexPage);
+        NodeStats& nodeStats = stats._nodes[_node];
+        for(size_t i = 0; i <= MAX_PAGES; i++){
+            SpanList& list = i < MAX_PAGES ? _spanList[i] : _largeSpanList;
+            PageListStats& pageList = stats._pageLists[i];
+            for(SpanList::Span* span = list.Begin(); span != list.End(); span = span->_next){
+                pageList._spans++;
+                pageList._pages += span->_numPages;
+                pageList._releasedPages += span->_releasedPages;
+                nodeStats._pageCacheBytes += span->_numPages << PAGE_SHIFT;
+                nodeStats._releasedBytes += span->_releasedPages << PAGE_SHIFT;
+            }
+        }
+        stats._pageCacheBytes += nodeStats._pageCacheBytes;
+        stats._releasedBytes += nodeStats._releasedBytes;
+        stats._largeAllocs += _largeAllocs;
+        stats._largeFrees += _largeFrees;
+        stats._largeObjectBytes += _largeBytes;
+        nodeStats._systemBytes = _systemPages << PAGE_SHIFT;
+        nodeStats._largeObjectBytes = _largeBytes;
+        nodeStats._borrowedSpans = _borrowedSpans;
+    }
+
+    void PageCache::startScavenger(uint64_t idleMs, uint64_t intervalMs) { // 只有一个回收线程，状态保存在节点0的实例上
+        PageCache& cache = getInstance(0);
+        std::unique_lock<std::mutex> lock(cache._mutexScavenger);
+        if(cache._scavenger.joinable()) return; // 已经在运行
+        cache._scavengerStop = false;
+        cache._scavenger = std::thread(&PageCache::scavengeLoop, &cache, idleMs * 1000000, intervalMs * 1000000);
+    }
+
+    void PageCache::stopScavenger() {
+        PageCache& cache = getInstance(0);
+        std::thread scavenger;
+        {
+            std::unique_lock<std::mutex> lock(cache._mutexScavenger);
+            if(!cache._scavenger.joinable()) return;
+            cache._scavengerStop = true;
+            scavenger.swap(cache._scavenger);
+        }
+        cache._scavengerCond.notify_all();
+        scavenger.join();
+    }
+
+    void PageCache::scavengeLoop(uint64_t idleNs, uint64_t intervalNs) {
+        std::unique_lock<std::mutex> lock(_mutexScavenger);
+        while(!_scavengerStop){
+            _scavengerCond.wait_for(lock, std::chrono::nanoseconds(intervalNs));
+            if(_scavengerStop) break;
+            lock.unlock(); // 回收期间不占用启停锁
+            for(size_t node = 0; node < nodeCount(); node++){
+                getInstance(node).releaseIdleSpans(idleNs);
+            }
+            lock.lock();
+        }
     }
 
 } // namespace MyMemoryPool
\ No newline at end of file
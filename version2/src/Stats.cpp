@@ -0,0 +1,138 @@
+#include "../include/Stats.h"
+#include "../include/ThreadCache.h"
+#include "../include/CentralCache.h"
+#include "../include/PageCache.h"
+#include "../include/CpuCache.h"
+#include <iomanip>
+
+namespace MyMemoryPool {
+
+std::atomic<size_t> systemMappedBytes{0};
+
+void collectPoolStats(PoolStats& stats) {
+    stats = PoolStats();
+    for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+        stats._classes[i]._objSize = SizeClass::classSize(i);
+    }
+    ThreadCache::collectStats(stats);
+    CentralCache::getInstance().collectStats(stats);
+    PageCache::collectStats(stats);
+    stats._cpuCacheBytes = CpuCache::getInstance().cachedBytes();
+    for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+        stats._transferCacheBytes += stats._classes[i]._transferCacheBytes;
+        stats._centralCacheBytes += stats._classes[i]._centralCacheBytes;
+        const SizeClassStats& cls = stats._classes[i];
+        if(cls._remoteFrees > cls._remoteCollects) { // 两个计数器由不同线程写入，读取期间可能短暂不一致
+            stats._remoteFreeBytes += (cls._remoteFrees - cls._remoteCollects) * cls._objSize;
+        }
+        stats._remoteFrees += cls._remoteFrees;
+    }
+    stats._mappedBytes = systemMappedBytes.load(std::memory_order_relaxed);
+}
+
+static bool isActive(const SizeClassStats& cls) { // 只输出用到过的size class
+    return cls._allocs != 0 || cls._frees != 0 || cls._spans != 0 || cls._transferCacheBytes != 0;
+}
+
+static void printText(std::ostream& os, const PoolStats& stats) {
+    os << "------------ 内存池统计 ------------\n";
+    os << "向系统申请(mmap):      " << (stats._mappedBytes >> 10) << " KB\n";
+    os << "ThreadCache缓存:       " << (stats._threadCacheBytes >> 10) << " KB (" << stats._threads << "个线程, 容量"
+       << (stats._threadCacheLimit >> 10) << " KB, 预算" << (stats._threadCacheBudget >> 10) << " KB)\n";
+    os << "CpuCache缓存:          " << (stats._cpuCacheBytes >> 10) << " KB\n";
+    os << "TransferCache缓存:     " << (stats._transferCacheBytes >> 10) << " KB\n";
+    os << "CentralCache空闲:      " << (stats._centralCacheBytes >> 10) << " KB\n";
+    os << "跨线程释放队列:        " << (stats._remoteFreeBytes >> 10) << " KB (累计" << stats._remoteFrees << "次)\n";
+    os << "PageCache空闲:         " << (stats._pageCacheBytes >> 10) << " KB (其中已归还系统 " << (stats._releasedBytes >> 10) << " KB)\n";
+    os << "大对象使用中:          " << (stats._largeObjectBytes >> 10) << " KB (分配" << stats._largeAllocs << "次, 释放" << stats._largeFrees << "次)\n";
+    if(stats._numaNodes > 1) { // 单节点时与上面的汇总相同，不单独输出
+        os << "------------ NUMA节点 ------------\n";
+        os << std::setw(6) << "node" << std::setw(14) << "system(KB)" << std::setw(14) << "pageFree(KB)"
+           << std::setw(14) << "central(KB)" << std::setw(12) << "large(KB)" << std::setw(10) << "borrowed" << "\n";
+        for(size_t i = 0; i < stats._numaNodes; i++){
+            const NodeStats& node = stats._nodes[i];
+            os << std::setw(6) << i << std::setw(14) << (node._systemBytes >> 10) << std::setw(14) << (node._pageCacheBytes >> 10)
+               << std::setw(14) << (node._centralCacheBytes >> 10) << std::setw(12) << (node._largeObjectBytes >> 10)
+               << std::setw(10) << node._borrowedSpans << "\n";
+        }
+    }
+    os << "------------ size class ------------\n";
+    os << std::setw(6) << "index" << std::setw(8) << "size" << std::setw(12) << "allocs" << std::setw(12) << "frees"
+       << std::setw(10) << "fetches" << std::setw(10) << "returns" << std::setw(12) << "thread(B)"
+       << std::setw(12) << "transfer(B)" << std::setw(12) << "central(B)" << std::setw(8) << "spans" << "\n";
+    for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+        const SizeClassStats& cls = stats._classes[i];
+        if(!isActive(cls)) continue;
+        os << std::setw(6) << i << std::setw(8) << cls._objSize << std::setw(12) << cls._allocs << std::setw(12) << cls._frees
+           << std::setw(10) << cls._fetches << std::setw(10) << cls._returns << std::setw(12) << cls._threadCacheBytes
+           << std::setw(12) << cls._transferCacheBytes << std::setw(12) << cls._centralCacheBytes << std::setw(8) << cls._spans << "\n";
+    }
+    os << "------------ PageCache空闲链表 ------------\n";
+    os << std::setw(8) << "pages" << std::setw(8) << "spans" << std::setw(12) << "totalPages" << std::setw(12) << "released" << "\n";
+    for(size_t i = 0; i <= MAX_PAGES; i++){
+        const PageListStats& pageList = stats._pageLists[i];
+        if(pageList._spans == 0) continue;
+        if(i < MAX_PAGES) os << std::setw(8) << i + 1;
+        else os << std::setw(8) << (">" + std::to_string(MAX_PAGES));
+        os << std::setw(8) << pageList._spans << std::setw(12) << pageList._pages << std::setw(12) << pageList._releasedPages << "\n";
+    }
+}
+
+static void printJson(std::ostream& os, const PoolStats& stats) {
+    os << "{\"mapped_bytes\":" << stats._mappedBytes
+       << ",\"threads\":" << stats._threads
+       << ",\"thread_cache_bytes\":" << stats._threadCacheBytes
+       << ",\"thread_cache_limit\":" << stats._threadCacheLimit
+       << ",\"thread_cache_budget\":" << stats._threadCacheBudget
+       << ",\"cpu_cache_bytes\":" << stats._cpuCacheBytes
+       << ",\"transfer_cache_bytes\":" << stats._transferCacheBytes
+       << ",\"central_cache_bytes\":" << stats._centralCacheBytes
+       << ",\"remote_free_bytes\":" << stats._remoteFreeBytes
+       << ",\"remote_frees\":" << stats._remoteFrees
+       << ",\"page_cache_bytes\":" << stats._pageCacheBytes
+       << ",\"released_bytes\":" << stats._releasedBytes
+       << ",\"large_object_bytes\":" << stats._largeObjectBytes
+       << ",\"large_allocs\":" << stats._largeAllocs
+       << ",\"large_frees\":" << stats._largeFrees
+       << ",\"numa_nodes\":[";
+    for(size_t i = 0; i < stats._numaNodes; i++){
+        const NodeStats& node = stats._nodes[i];
+        os << (i == 0 ? "" : ",") << "{\"node\":" << i << ",\"system_bytes\":" << node._systemBytes
+           << ",\"page_cache_bytes\":" << node._pageCacheBytes << ",\"released_bytes\":" << node._releasedBytes
+           << ",\"central_cache_bytes\":" << node._centralCacheBytes << ",\"large_object_bytes\":" << node._largeObjectBytes
+           << ",\"borrowed_spans\":" << node._borrowedSpans << "}";
+    }
+    os << "],\"size_classes\":[";
+    bool first = true;
+    for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+        const SizeClassStats& cls = stats._classes[i];
+        if(!isActive(cls)) continue;
+        os << (first ? "" : ",") << "{\"index\":" << i << ",\"size\":" << cls._objSize
+           << ",\"allocs\":" << cls._allocs << ",\"frees\":" << cls._frees
+           << ",\"fetches\":" << cls._fetches << ",\"returns\":" << cls._returns
+           << ",\"remote_frees\":" << cls._remoteFrees
+           << ",\"thread_cache_bytes\":" << cls._threadCacheBytes
+           << ",\"transfer_cache_bytes\":" << cls._transferCacheBytes
+           << ",\"central_cache_bytes\":" << cls._centralCacheBytes
+           << ",\"spans\":" << cls._spans << "}";
+        first = false;
+    }
+    os << "],\"page_lists\":[";
+    first = true;
+    for(size_t i = 0; i <= MAX_PAGES; i++){
+        const PageListStats& pageList = stats._pageLists[i];
+        if(pageList._spans == 0) continue;
+        os << (first ? "" : ",") << "{\"pages\":" << (i < MAX_PAGES ? i + 1 : 0) // 0表示页数超过MAX_PAGES的链表
+           << ",\"spans\":" << pageList._spans << ",\"total_pages\":" << pageList._pages
+           << ",\"released_pages\":" << pageList._releasedPages << "}";
+        first = false;
+    }
+    os << "]}\n";
+}
+
+void printPoolStats(std::ostream& os, const PoolStats& stats, bool json) {
+    if(json) printJson(os, stats);
+    else printText(os, stats);
+}
+
+} // namespace MyMemoryPool
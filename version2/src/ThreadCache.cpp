@@ -1,78 +1,571 @@
 #include "../include/ThreadCache.h"
 #include "../include/CentralCache.h"
+#include "../include/PageCache.h"
 
 namespace MyMemoryPool {
 
-thread_local ThreadCache* ptrTLSThreadCache = nullptr; // 定义线程局部存储的ThreadCache指针
-std::vector<size_t> ThreadCache::_batchNum(FREE_LIST_SIZE, 1); // 初始化批量分配的数量
+thread_local ThreadCache* ptrTLSThreadCache __attribute__((tls_model("initial-exec"))) = nullptr; // 定义线程局部存储的ThreadCache指针
+DtLenMemoryPool<ThreadCache> ThreadCache::_tcPool;
+pthread_key_t ThreadCache::_threadKey;
+pthread_once_t ThreadCache::_threadKeyOnce = PTHREAD_ONCE_INIT;
+std::mutex ThreadCache::_registryMutex;
+ThreadCache* ThreadCache::_registryHead = nullptr;
+ThreadCache* ThreadCache::_stealCursor = nullptr;
+size_t ThreadCache::_budget = THREAD_CACHE_BUDGET;
+ptrdiff_t ThreadCache::_unclaimedBudget = THREAD_CACHE_BUDGET;
+SizeClassStats ThreadCache::_retiredStats[FREE_LIST_SIZE];
+std::atomic<bool> ThreadCache::_remoteFreeMode{false};
+DtLenMemoryPool<RemoteFreeQueue> ThreadCache::_queuePool;
+std::atomic<RemoteFreeQueue*> ThreadCache::_remoteQueues[MAX_REMOTE_FREE_OWNERS];
+uint32_t ThreadCache::_nextOwnerId = 1; // 0表示没有所有者
+RemoteFreeQueue* ThreadCache::_freeQueues = nullptr;
 // ThreadCache ThreadCache::_instance; // 静态实例化ThreadCache单例
 
+static const uint16_t MAX_OVERAGES = 3; // 自由链表连续超长的次数达到此值后缩小_maxLength
+static const int MAX_STEAL_TRIES = 10; // 一次最多尝试从多少个线程处窃取容量
+static const uint64_t BUSY_THREAD_NS = 10 * 1000 * 1000; // 10ms内扩大过容量的线程视为忙线程
+
 void* ThreadCache::allocate(size_t size) {
     if(size == 0) {
         std::cerr << "Error: Attempt to allocate zero size memory." << std::endl;
         return nullptr;
     }
-    if(size > MAX_BYTES){ // 大于最大字节数，直接调用系统分配
-        return malloc(size);
+    // 堆采样的倒计数：不采样的分配只多一次减法和分支，慢路径以尾调用进入
+    if(HeapProfiler::charge(_sampleCountdown, size)) return allocateSampled(size);
+    return allocateObject(size);
+}
+
+void* ThreadCache::allocateSampled(size_t size) {
+    void* ptr = allocateObject(size);
+    HeapProfiler::sampleAllocation(_sampleCountdown, _sampleState, ptr, size);
+    return ptr;
+}
+
+void* ThreadCache::countAllocation(void* ptr, size_t size) {
+    if(HeapProfiler::charge(_sampleCountdown, size)) HeapProfiler::sampleAllocation(_sampleCountdown, _sampleState, ptr, size);
+    return ptr;
+}
+
+inline void* ThreadCache::allocateObject(size_t size) {
+    if(size > MAX_BYTES){ // 大于最大字节数，直接从PageCache分配整数页的Span
+        return PageCache::getInstance().AllocLargeObject(size);
     }
 
     size_t index = SizeClass::getIndex(size);
-    size_t alignedSize = SizeClass::alignMemory(size);
-    if(_freeList[index] == nullptr) { //链表为空，向中心缓存申请内存
+    size_t alignedSize = SizeClass::classSize(index);
+    STAT_ADD(_freeList[index]._allocs, 1);
+    if(_freeList[index]._head == nullptr) { //链表为空，向中心缓存申请内存
         return getMemoryFromCentralCache(index, alignedSize);
     }else{ //从链表头部分配一块空闲的内存
-        void* ptr = _freeList[index];
-        _freeList[index] = ptrNext(ptr);
-        _freeListLength[index]--;
+        void* ptr = _freeList[index]._head;
+        _freeList[index]._head = ptrNext(ptr);
+        if(--_freeList[index]._length < _freeList[index]._lowWater) _freeList[index]._lowWater = _freeList[index]._length;
+        _size.store(_size.load(std::memory_order_relaxed) - alignedSize, std::memory_order_relaxed);
         return ptr;
     }
 }
 
 void ThreadCache::deallocate(void* ptr, size_t size){
     assert(ptr != nullptr && size > 0);
-    if(size > MAX_BYTES) { // 大于最大字节数，直接调用系统释放
-        return free(ptr);
+    if(size > MAX_BYTES) { // 大于最大字节数，Span直接归还给PageCache
+        return PageCache::FreeLargeObject(ptr);
     }
+    // 可能是采样对象时在单独的函数中先从存活表移除，同样以尾调用进入；没有存活的采样时只有一次读取和分支
+    if(HeapProfiler::mayBeSampled(ptr)) return deallocateSampled(ptr, size);
+    deallocateObject(ptr, size);
+}
+
+void ThreadCache::deallocateSampled(void* ptr, size_t size) {
+    HeapProfiler::recordFree(ptr);
+    deallocateObject(ptr, size);
+}
+
+inline void ThreadCache::deallocateObject(void* ptr, size_t size) {
     size_t index = SizeClass::getIndex(size);
-    ptrNext(ptr) = _freeList[index]; // 将释放的内存插入回链表头
-    _freeList[index] = ptr;
-    _freeListLength[index]++;
+    size_t alignedSize = SizeClass::classSize(index);
+    STAT_ADD(_freeList[index]._frees, 1);
+    // 跨线程释放放在单独的函数中尾调用，快速路径上不会因为中途的函数调用而需要保存寄存器
+    if(_remoteFreeMode.load(std::memory_order_relaxed)) return freeRemote(ptr, index, alignedSize);
+    pushFreeList(ptr, index, alignedSize);
+}
 
-    if(isReturnToCentralCache(index)) returnMemoryToCentralCache(_freeList[index], size);
+size_t ThreadCache::allocateBatch(size_t size, size_t n, void** out) {
+    if(size == 0 || n == 0) return 0;
+    if(size > MAX_BYTES){ // 大对象各自独占Span，没有可以批量的部分
+        for(size_t i = 0; i < n; i++){
+            out[i] = countAllocation(PageCache::getInstance().AllocLargeObject(size), size);
+            if(out[i] == nullptr) return i;
+        }
+        return n;
+    }
+    size_t index = SizeClass::getIndex(size);
+    size_t alignedSize = SizeClass::classSize(index);
+    FreeList& list = _freeList[index];
+    STAT_ADD(list._allocs, n);
+    if(_remoteQueue != nullptr && list._length < n) collectRemoteFrees(index, alignedSize);
+    size_t got = 0;
+    void* ptr = list._head;
+    while(got < n && ptr != nullptr){ // 自由链表中已有的内存块
+        out[got++] = ptr;
+        ptr = ptrNext(ptr);
+    }
+    list._head = ptr;
+    list._length -= got;
+    if(list._length < list._lowWater) list._lowWater = list._length;
+    _size.store(_size.load(std::memory_order_relaxed) - got * alignedSize, std::memory_order_relaxed);
+    if(got < n && list._maxLength < n) { // 一次要n个，之后整批释放时允许自由链表留下n个，总量仍受_maxSize限制
+        list._maxLength = std::min<size_t>(n, MAX_DYNAMIC_FREELIST_LENGTH);
+    }
+    while(got < n){ // 其余部分按整条链表取，不经过慢开始，也不逐个进出自由链表
+        void* start = nullptr;
+        void* end = nullptr;
+        size_t want = std::min<size_t>(n - got, MAX_FREELIST_NUMBERS);
+        size_t result = CentralCache::getInstance().FetchMemoryForThreadCache(start, end, want, alignedSize, _ownerId);
+        STAT_ADD(_stats._fetches[index], 1);
+        STAT_ADD(_stats._fetchedObjects[index], result);
+        size_t taken = 0;
+        for(ptr = start; taken < result && got < n; taken++){
+            out[got++] = ptr;
+            ptr = ptrNext(ptr);
+        }
+        if(taken < result){ // TransferCache中的批次可能多于所需，剩余的[ptr, end]挂回自由链表
+            ptrNext(end) = list._head;
+            list._head = ptr;
+            list._length += result - taken;
+            _size.store(_size.load(std::memory_order_relaxed) + (result - taken) * alignedSize, std::memory_order_relaxed);
+        }
+    }
+    return n;
 }
 
-bool ThreadCache::isReturnToCentralCache(size_t index) {
-    return _freeListLength[index] > MAX_FREELIST_NUMBERS;
+void ThreadCache::deallocateBatch(size_t size, size_t n, void** ptrs) {
+    if(n == 0) return;
+    assert(size > 0);
+    if(size > MAX_BYTES){
+        for(size_t i = 0; i < n; i++) PageCache::FreeLargeObject(ptrs[i]);
+        return;
+    }
+    size_t index = SizeClass::getIndex(size);
+    size_t alignedSize = SizeClass::classSize(index);
+    FreeList& list = _freeList[index];
+    STAT_ADD(list._frees, n);
+    if(HeapProfiler::liveSamples() != 0) {
+        for(size_t k = 0; k < n; k++) {
+            if(HeapProfiler::mayBeSampled(ptrs[k])) HeapProfiler::recordFree(ptrs[k]);
+        }
+    }
+    // 自由链表还放得下的部分留在本线程，下一次批量分配直接取用；超出_maxSize时与逐个释放一样由scavenge归还并扩大容量
+    size_t room = list._maxLength > list._length ? list._maxLength - list._length : 0;
+    size_t keep = std::min(n, room);
+    size_t batchNum = SizeClass::batchNum(index);
+    size_t i = keep;
+    for(; n - i >= batchNum; i += batchNum){ // 超出的部分每满一批直接交给CentralCache，批次大小与平时归还的一致
+        for(size_t k = i; k + 1 < i + batchNum; k++) ptrNext(ptrs[k]) = ptrs[k + 1];
+        ptrNext(ptrs[i + batchNum - 1]) = nullptr;
+        STAT_ADD(_stats._returns[index], 1);
+        STAT_ADD(_stats._returnedObjects[index], batchNum);
+        CentralCache::getInstance().ReturnMemoryFromThreadCache(ptrs[i], ptrs[i + batchNum - 1], batchNum, alignedSize);
+    }
+    size_t kept = keep + (n - i); // 前keep个和不足一批的尾部串成一条链表放入自由链表
+    if(kept == 0) return;
+    void* head = list._head;
+    for(size_t k = n; k > i; k--){
+        ptrNext(ptrs[k - 1]) = head;
+        head = ptrs[k - 1];
+    }
+    for(size_t k = keep; k > 0; k--){
+        ptrNext(ptrs[k - 1]) = head;
+        head = ptrs[k - 1];
+    }
+    list._head = head;
+    list._length += kept;
+    size_t cached = _size.load(std::memory_order_relaxed) + kept * alignedSize;
+    _size.store(cached, std::memory_order_relaxed);
+    if(list._length > list._maxLength) listTooLong(index, alignedSize);
+    else if(cached > _maxSize.load(std::memory_order_relaxed)) scavenge();
+}
+
+inline void ThreadCache::pushFreeList(void* ptr, size_t index, size_t alignedSize) {
+    ptrNext(ptr) = _freeList[index]._head; // 将释放的内存插入回链表头
+    _freeList[index]._head = ptr;
+    _freeList[index]._length++;
+    size_t cached = _size.load(std::memory_order_relaxed) + alignedSize;
+    _size.store(cached, std::memory_order_relaxed);
+
+    if(_freeList[index]._length > _freeList[index]._maxLength) listTooLong(index, alignedSize);
+    else if(cached > _maxSize.load(std::memory_order_relaxed)) scavenge();
+}
+
+void ThreadCache::freeRemote(void* ptr, size_t index, size_t alignedSize) {
+    uint32_t owner = PageCache::getIdOfSpan(ptr)->_owner.load(std::memory_order_relaxed);
+    if(owner != 0 && owner != _ownerId) {
+        RemoteFreeQueue* queue = _remoteQueues[owner].load(std::memory_order_acquire);
+        if(queue != nullptr && queue->push(index, ptr)) {
+            STAT_ADD(_stats._remoteFrees[index], 1);
+            return;
+        }
+    }
+    pushFreeList(ptr, index, alignedSize); // 没有所有者、属于本线程或所有者已退出，放入本线程的缓存
+}
+
+size_t ThreadCache::collectRemoteFrees(size_t index, size_t alignedSize) {
+    void* start = _remoteQueue->popAll(index);
+    if(start == nullptr) return 0;
+    FreeList& list = _freeList[index];
+    // 消费者可能攒下了大量内存块，自由链表最多放到_maxLength与一批中的较大者，其余直接归还给CentralCache
+    size_t limit = std::max<size_t>(list._maxLength, SizeClass::batchNum(index));
+    size_t room = list._length < limit ? limit - list._length : 0;
+    size_t count = 0;
+    size_t kept = 0;
+    void* end = start;
+    for(void* ptr = start; ptr != nullptr; ptr = ptrNext(ptr)) {
+        count++;
+        if(kept < room) {
+            end = ptr;
+            kept++;
+        }
+    }
+    STAT_ADD(_stats._remoteCollects[index], count);
+    void* rest = ptrNext(end);
+    if(kept == 0) {
+        rest = start;
+    }else {
+        ptrNext(end) = list._head;
+        list._head = start;
+        list._length += kept;
+        _size.store(_size.load(std::memory_order_relaxed) + kept * alignedSize, std::memory_order_relaxed);
+    }
+    if(rest != nullptr) {
+        STAT_ADD(_stats._returns[index], 1);
+        STAT_ADD(_stats._returnedObjects[index], count - kept);
+        CentralCache::getInstance().FreeMemoryToSpanList(rest, alignedSize);
+    }
+    return kept;
+}
+
+void ThreadCache::closeRemoteFrees() {
+    for(size_t index = 0; index < FREE_LIST_SIZE; index++) {
+        void* start = _remoteQueue->close(index);
+        if(start == nullptr) continue;
+        size_t count = 0;
+        for(void* ptr = start; ptr != nullptr; ptr = ptrNext(ptr)) count++;
+        STAT_ADD(_stats._remoteCollects[index], count);
+        STAT_ADD(_stats._returns[index], 1);
+        STAT_ADD(_stats._returnedObjects[index], count);
+        CentralCache::getInstance().FreeMemoryToSpanList(start, SizeClass::classSize(index));
+    }
 }
 
 void* ThreadCache::getMemoryFromCentralCache(size_t index, size_t alignedSize) {
-    size_t batchNum = std::min(getBatchNum(index), SizeClass::normBatchNum(alignedSize)); // 批量获取的数量，取规范化和当前批量分配数量的最小值，实现慢开始调节算法
+    FreeList& list = _freeList[index];
+    if(_remoteQueue != nullptr && collectRemoteFrees(index, alignedSize) > 0) { // 先取回其他线程释放的、本线程取走过的内存块
+        void* ptr = list._head;
+        list._head = ptrNext(ptr);
+        list._length--;
+        _size.store(_size.load(std::memory_order_relaxed) - alignedSize, std::memory_order_relaxed);
+        return ptr;
+    }
+    // 慢开始调节算法：每个线程的每个自由链表独立调节，_maxLength小于一批时每次翻倍，之后每次增加一批
+    size_t batchNum = SizeClass::batchNum(index);
+    size_t num = std::min<size_t>(list._maxLength, batchNum);
+    size_t cached = _size.load(std::memory_order_relaxed);
+    size_t maxSize = _maxSize.load(std::memory_order_relaxed);
+    size_t room = cached < maxSize ? (maxSize - cached) / alignedSize : 0; // 不一次取超过剩余容量的对象，避免取来后马上又被scavenge归还
+    if(num > room + 1) num = room + 1;
+    if(list._maxLength < batchNum) {
+        list._maxLength = std::min<size_t>(list._maxLength * 2, batchNum);
+    }else {
+        list._maxLength = std::min<size_t>(list._maxLength + batchNum, MAX_DYNAMIC_FREELIST_LENGTH);
+    }
     void* start = nullptr;
     void* end = nullptr;
-    size_t result = CentralCache::getInstance().FetchMemoryForThreadCache(start, end, batchNum, alignedSize);
+    size_t result = CentralCache::getInstance().FetchMemoryForThreadCache(start, end, num, alignedSize, _ownerId);
+    STAT_ADD(_stats._fetches[index], 1);
+    STAT_ADD(_stats._fetchedObjects[index], result);
     if(result == 1){
         assert(start == end);
         return start; // 只返回了一个内存块，说明头指针和尾指针指向同一个地址
     } else{ // 从CentralCache中获取到了多个连续内存块，将第一个返回，其余的头插到对应的自由链表
-        ptrNext(end) = _freeList[index]; // 将尾指针的下一个指针指向当前自由链表的头
-        _freeList[index] = ptrNext(start); // 将链表头指针指向批量内存块头指针指向的下一个内存块（保留一个用于返回）
+        ptrNext(end) = list._head; // 将尾指针的下一个指针指向当前自由链表的头
+        list._head = ptrNext(start); // 将链表头指针指向批量内存块头指针指向的下一个内存块（保留一个用于返回）
         ptrNext(start) = nullptr; // 将第一个内存块的下一个指针置为nullptr
-        _freeListLength[index] += batchNum - 1; // 更新当前自由链表的长度
+        list._length += result - 1; // 更新当前自由链表的长度（CentralCache可能返回少于或多于num个）
+        _size.store(_size.load(std::memory_order_relaxed) + (result - 1) * alignedSize, std::memory_order_relaxed);
         return start; // 返回第一个内存块
     }
 }
 
-void ThreadCache::returnMemoryToCentralCache(void*& freelist, size_t size) {
-    void* start = freelist;
+void ThreadCache::returnMemoryToCentralCache(size_t index, size_t alignedSize, size_t num) {
+    FreeList& list = _freeList[index];
+    assert(num > 0 && num <= list._length);
+    void* start = list._head;
     void* end = start;
-    size_t index = SizeClass::getIndex(size);
-    for(size_t i = 1; i < _batchNum[index]; i++) { // 慢开始算法控制要返回的内存块数量
+    for(size_t i = 1; i < num; i++) {
         end = ptrNext(end);
     }
-    freelist = ptrNext(end); // 更新自由链表头指针
+    list._head = ptrNext(end); // 更新自由链表头指针
     ptrNext(end) = nullptr; // 断开链表
-    _freeListLength[index] -= _batchNum[index];
-    CentralCache::getInstance().FreeMemoryToSpanList(start, size);
+    list._length -= num;
+    if(list._length < list._lowWater) list._lowWater = list._length;
+    _size.store(_size.load(std::memory_order_relaxed) - num * alignedSize, std::memory_order_relaxed);
+    STAT_ADD(_stats._returns[index], 1);
+    STAT_ADD(_stats._returnedObjects[index], num);
+    CentralCache::getInstance().ReturnMemoryFromThreadCache(start, end, num, alignedSize);
+}
+
+void ThreadCache::listTooLong(size_t index, size_t alignedSize) {
+    FreeList& list = _freeList[index];
+    size_t batchNum = SizeClass::batchNum(index);
+    if(list._maxLength < batchNum) { // 还在慢开始阶段，释放多的线程也允许缓存更多，先不归还，缓存总量仍受_maxSize限制
+        list._maxLength = std::min<size_t>(list._maxLength * 2, batchNum);
+        return;
+    }
+    returnMemoryToCentralCache(index, alignedSize, std::min<size_t>(batchNum, list._length));
+    if(list._maxLength > batchNum) { // 反复超长说明缓存的对象多半用不上，缩小一批
+        if(++list._overages > MAX_OVERAGES) {
+            list._maxLength -= batchNum;
+            list._overages = 0;
+        }
+    }
+    // 容量可能已被其他线程窃取，归还一批后仍然超出时同样需要收缩
+    if(_size.load(std::memory_order_relaxed) > _maxSize.load(std::memory_order_relaxed)) scavenge();
+}
+
+void ThreadCache::scavenge() {
+    for(size_t index = 0; index < FREE_LIST_SIZE; index++) {
+        FreeList& list = _freeList[index];
+        // 顺带取回跨线程释放队列中的内存块，所有者不再分配某个size class时它们也不会一直滞留在队列中
+        if(_remoteQueue != nullptr) collectRemoteFrees(index, SizeClass::classSize(index));
+        if(list._lowWater == 0) { // 期间被取空过，缓存的对象都用得上
+            list._lowWater = list._length;
+            continue;
+        }
+        size_t alignedSize = SizeClass::classSize(index);
+        size_t batchNum = SizeClass::batchNum(index);
+        size_t drop = list._lowWater > 1 ? list._lowWater / 2 : 1;
+        while(drop > 0) { // 按批归还，TransferCache中的批次大小保持一致
+            size_t num = std::min(drop, batchNum);
+            returnMemoryToCentralCache(index, alignedSize, num);
+            drop -= num;
+        }
+        if(list._maxLength > batchNum) {
+            list._maxLength = std::max<size_t>(list._maxLength - batchNum, batchNum);
+        }
+        list._lowWater = list._length;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        increaseCacheLimit(); // 容量不够用，说明本线程较忙，尝试扩大容量
+        repayOwed();
+    }
+    if(_size.load(std::memory_order_relaxed) <= _maxSize.load(std::memory_order_relaxed)) return;
+    shrinkToLimit(); // 没能扩大容量，或者容量被其他线程窃取，归还到容量以内，归还时不持有_registryMutex
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    repayOwed();
+}
+
+void ThreadCache::shrinkToLimit() {
+    // 归还到容量的3/4，留出余量，避免之后每次释放都超出容量而进入scavenge
+    size_t target = _maxSize.load(std::memory_order_relaxed) / 4 * 3;
+    for(size_t index = FREE_LIST_SIZE; index > 0; index--) { // 大对象的链表在后面，归还的次数少
+        FreeList& list = _freeList[index - 1];
+        size_t alignedSize = SizeClass::classSize(index - 1);
+        size_t batchNum = SizeClass::batchNum(index - 1);
+        while(list._length > 0 && _size.load(std::memory_order_relaxed) > target) {
+            returnMemoryToCentralCache(index - 1, alignedSize, std::min<size_t>(list._length, batchNum));
+        }
+        if(_size.load(std::memory_order_relaxed) <= target) return;
+    }
+}
+
+void ThreadCache::repayOwed() {
+    // _size只由本线程写入，_maxSize只在持有_registryMutex时减小，检查通过后扣除的容量确实已经空出
+    if(_owedBytes == 0 || _size.load(std::memory_order_relaxed) > _maxSize.load(std::memory_order_relaxed)) return;
+    _unclaimedBudget += _owedBytes;
+    _owedBytes = 0;
+}
+
+void ThreadCache::increaseCacheLimit() {
+    size_t maxSize = _maxSize.load(std::memory_order_relaxed);
+    uint64_t now = monotonicNs();
+    _lastGrowNs = now;
+    if(_unclaimedBudget < 0 && maxSize > MIN_THREAD_CACHE_SIZE) { // 预算被调小或线程过多导致超额分配，忙线程也先让出容量
+        size_t give = std::min<size_t>(maxSize - MIN_THREAD_CACHE_SIZE, (size_t)-_unclaimedBudget);
+        _maxSize.store(maxSize - give, std::memory_order_relaxed);
+        _owedBytes += give; // 归还到新的容量以内后才还给预算
+        return;
+    }
+    if(maxSize >= MAX_THREAD_CACHE_SIZE) return;
+    size_t want = std::min<size_t>(maxSize, MAX_THREAD_CACHE_SIZE - maxSize); // 容量每次最多翻倍，新线程很快就能达到所需的容量
+    if(_unclaimedBudget >= THREAD_CACHE_STEAL_SIZE) { // 优先使用未分配的预算
+        size_t grow = std::min<size_t>(want, (size_t)_unclaimedBudget);
+        _unclaimedBudget -= grow;
+        _maxSize.store(maxSize + grow, std::memory_order_relaxed);
+        return;
+    }
+    // 轮流从其他线程窃取，被窃取的线程在下一次释放时发现超出容量并归还内存
+    // 最近扩大过容量的线程同样很忙，不从它那里窃取，避免忙线程之间来回窃取
+    // 对方还缓存着的部分要等它归还后才能使用，这次没有拿到立即可用的容量时继续尝试下一个线程
+    for(int i = 0; i < MAX_STEAL_TRIES; i++) {
+        if(_stealCursor == nullptr) _stealCursor = _registryHead;
+        ThreadCache* victim = _stealCursor;
+        _stealCursor = victim->_nextTC;
+        if(victim == this || now - victim->_lastGrowNs < BUSY_THREAD_NS) continue;
+        size_t victimSize = victim->_maxSize.load(std::memory_order_relaxed);
+        if(victimSize < MIN_THREAD_CACHE_SIZE + THREAD_CACHE_STEAL_SIZE) continue;
+        size_t steal = std::min<size_t>(std::max<size_t>(want / 2, THREAD_CACHE_STEAL_SIZE), victimSize - MIN_THREAD_CACHE_SIZE);
+        victim->_maxSize.store(victimSize - steal, std::memory_order_relaxed);
+        size_t victimCached = victim->_size.load(std::memory_order_relaxed); // 对方之后缓存得更多时会在释放时发现超出容量并归还
+        size_t unused = victimSize > victimCached ? victimSize - victimCached : 0;
+        if(unused < steal) {
+            victim->_owedBytes += steal - unused;
+            steal = unused;
+        }
+        if(steal == 0) continue;
+        if(_unclaimedBudget < 0) { // 超额分配时窃取到的容量先用来填补预算
+            size_t repay = std::min<size_t>(steal, (size_t)-_unclaimedBudget);
+            _unclaimedBudget += repay;
+            steal -= repay;
+        }
+        _maxSize.store(maxSize + steal, std::memory_order_relaxed);
+        return;
+    }
+}
+
+void ThreadCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    _unclaimedBudget += (ptrdiff_t)bytes - (ptrdiff_t)_budget;
+    _budget = bytes;
+}
+
+void ThreadCache::releaseAll() {
+    for(size_t index = 0; index < FREE_LIST_SIZE; index++) {
+        if(_remoteQueue != nullptr) collectRemoteFrees(index, SizeClass::classSize(index));
+        if(_freeList[index]._head == nullptr) continue;
+        // 同一个桶里的内存块大小相同，由第一个内存块所属Span记录的对象大小确定size
+        size_t size = PageCache::getIdOfSpan(_freeList[index]._head)->_objSize;
+        void* start = _freeList[index]._head;
+        STAT_ADD(_stats._returns[index], 1);
+        STAT_ADD(_stats._returnedObjects[index], _freeList[index]._length);
+        _freeList[index]._head = nullptr;
+        _freeList[index]._length = 0;
+        _freeList[index]._lowWater = 0;
+        CentralCache::getInstance().FreeMemoryToSpanList(start, size); // 整条链表一次归还，只加一次锁
+    }
+    _size.store(0, std::memory_order_relaxed);
+}
+
+void ThreadCache::createThreadKey() {
+    pthread_key_create(&_threadKey, destroyThreadCache);
+    HeapProfiler::initFromEnv();
+}
+
+void ThreadCache::setSampleInterval(size_t bytes) {
+    HeapProfiler::setSampleInterval(bytes);
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    for(ThreadCache* tc = _registryHead; tc != nullptr; tc = tc->_nextTC){
+        // 与所属线程的递减并发时可能被覆盖，最多推迟到所属线程下一次进入慢路径（关闭采样时每HEAP_PROFILE_DISABLED_BYTES字节一次）
+        tc->_sampleCountdown.store(0, std::memory_order_relaxed);
+    }
+}
+
+ThreadCache* ThreadCache::createThreadCache() {
+    pthread_once(&_threadKeyOnce, createThreadKey);
+    ThreadCache* tc = _tcPool.New();
+    {
+        std::lock_guard<std::mutex> lock(_registryMutex);
+        tc->_maxSize.store(MIN_THREAD_CACHE_SIZE, std::memory_order_relaxed); // 新线程先取最小容量，预算不足时允许超额，由忙线程逐步让出
+        _unclaimedBudget -= MIN_THREAD_CACHE_SIZE;
+        RemoteFreeQueue* queue = _freeQueues; // 优先复用已退出线程的编号和队列
+        if(queue != nullptr) {
+            _freeQueues = queue->_nextFree;
+            queue->open();
+        }else if(_nextOwnerId < MAX_REMOTE_FREE_OWNERS) {
+            queue = _queuePool.New();
+            if(queue != nullptr) {
+                queue->_ownerId = _nextOwnerId++;
+                _remoteQueues[queue->_ownerId].store(queue, std::memory_order_release);
+            }
+        }
+        tc->_remoteQueue = queue;
+        tc->_ownerId = queue != nullptr ? queue->_ownerId : 0;
+        tc->_sampleState = 0x9e3779b97f4a7c15ULL * (reinterpret_cast<uintptr_t>(tc) | 1) + monotonicNs(); // 每个线程的间隔序列不同
+        tc->_sampleCountdown.store(HeapProfiler::nextCountdown(tc->_sampleState), std::memory_order_relaxed);
+        tc->_nextTC = _registryHead;
+        if(_registryHead != nullptr) _registryHead->_prevTC = tc;
+        _registryHead = tc;
+    }
+    ptrTLSThreadCache = tc;
+    pthread_setspecific(_threadKey, ptrTLSThreadCache); // 非空值才会在线程退出时触发析构回调
+    if(HeapProfiler::sampleInterval() != 0) HeapProfiler::warmUp(); // 由环境变量开启采样时在这里预热，backtrace的分配可以使用本线程的ThreadCache
+    return ptrTLSThreadCache;
+}
+
+void ThreadCache::destroyThreadCache(void* ptr) {
+    ThreadCache* tc = static_cast<ThreadCache*>(ptr);
+    RemoteFreeQueue* queue = tc->_remoteQueue;
+    if(queue != nullptr) tc->closeRemoteFrees(); // 先关闭队列，之后其他线程不再向这里释放
+    tc->_remoteQueue = nullptr;
+    tc->releaseAll();
+    {
+        std::lock_guard<std::mutex> lock(_registryMutex); // 从链表中摘除，容量还给预算，计数器并入累计值
+        _unclaimedBudget += tc->_maxSize.load(std::memory_order_relaxed) + tc->_owedBytes; // releaseAll已归还全部内存
+        if(_stealCursor == tc) _stealCursor = tc->_nextTC;
+        if(tc->_prevTC != nullptr) tc->_prevTC->_nextTC = tc->_nextTC;
+        else _registryHead = tc->_nextTC;
+        if(tc->_nextTC != nullptr) tc->_nextTC->_prevTC = tc->_prevTC;
+        if(queue != nullptr) {
+            queue->_nextFree = _freeQueues;
+            _freeQueues = queue;
+        }
+        for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+            _retiredStats[i]._allocs += tc->_freeList[i]._allocs.load(std::memory_order_relaxed);
+            _retiredStats[i]._frees += tc->_freeList[i]._frees.load(std::memory_order_relaxed);
+            _retiredStats[i]._fetches += tc->_stats._fetches[i].load(std::memory_order_relaxed);
+            _retiredStats[i]._returns += tc->_stats._returns[i].load(std::memory_order_relaxed);
+            _retiredStats[i]._remoteFrees += tc->_stats._remoteFrees[i].load(std::memory_order_relaxed);
+            _retiredStats[i]._remoteCollects += tc->_stats._remoteCollects[i].load(std::memory_order_relaxed);
+        }
+    }
+    if(ptrTLSThreadCache == tc) {
+        ptrTLSThreadCache = nullptr; // 之后若还有其他TLS析构函数使用内存池，会重新创建一个ThreadCache
+    }
+    _tcPool.Delete(tc); // 归还给定长内存池，供后续新线程复用
+}
+
+void ThreadCache::collectStats(PoolStats& stats) {
+    std::lock_guard<std::mutex> lock(_registryMutex);
+    for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+        stats._classes[i]._allocs += _retiredStats[i]._allocs;
+        stats._classes[i]._frees += _retiredStats[i]._frees;
+        stats._classes[i]._fetches += _retiredStats[i]._fetches;
+        stats._classes[i]._returns += _retiredStats[i]._returns;
+        stats._classes[i]._remoteFrees += _retiredStats[i]._remoteFrees;
+        stats._classes[i]._remoteCollects += _retiredStats[i]._remoteCollects;
+    }
+    stats._threadCacheBudget = _budget;
+    for(ThreadCache* tc = _registryHead; tc != nullptr; tc = tc->_nextTC){
+        stats._threads++;
+        stats._threadCacheBytes += tc->_size.load(std::memory_order_relaxed);
+        stats._threadCacheLimit += tc->_maxSize.load(std::memory_order_relaxed) + tc->_owedBytes; // 被扣除但尚未归还的容量仍然算作该线程占用的预算
+        for(size_t i = 0; i < FREE_LIST_SIZE; i++){
+            const ThreadCacheStats& counters = tc->_stats;
+            uint64_t allocs = tc->_freeList[i]._allocs.load(std::memory_order_relaxed);
+            uint64_t frees = tc->_freeList[i]._frees.load(std::memory_order_relaxed);
+            stats._classes[i]._allocs += allocs;
+            stats._classes[i]._frees += frees;
+            stats._classes[i]._fetches += counters._fetches[i].load(std::memory_order_relaxed);
+            stats._classes[i]._returns += counters._returns[i].load(std::memory_order_relaxed);
+            uint64_t remoteFrees = counters._remoteFrees[i].load(std::memory_order_relaxed);
+            uint64_t remoteCollects = counters._remoteCollects[i].load(std::memory_order_relaxed);
+            stats._classes[i]._remoteFrees += remoteFrees;
+            stats._classes[i]._remoteCollects += remoteCollects;
+            // 缓存中的对象数 = 获取的 + 释放的 + 取回的 - 分配的 - 归还的 - 放入其他线程队列的，读取期间所属线程仍在运行，结果只是近似值
+            int64_t cached = (int64_t)(counters._fetchedObjects[i].load(std::memory_order_relaxed) + frees + remoteCollects)
+                - (int64_t)(allocs + counters._returnedObjects[i].load(std::memory_order_relaxed) + remoteFrees);
+            if(cached > 0) stats._classes[i]._threadCacheBytes += (size_t)cached * SizeClass::classSize(i);
+        }
+    }
 }
 
-} // namespace MyMemoryPool
\ No newline at end of file
+} // namespace MyMemoryPool
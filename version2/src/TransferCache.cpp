@@ -0,0 +1,55 @@
+#include "../include/TransferCache.h"
+
+namespace MyMemoryPool {
+
+bool TransferCache::push(void* start, void* end, size_t count) {
+    size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+    while(true) {
+        Slot& slot = _slots[pos % _capacity];
+        size_t seq = slot._seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0) { // 槽位空闲，尝试占用
+            if(_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot._start = start;
+                slot._end = end;
+                slot._count = count;
+                slot._seq.store(pos + 1, std::memory_order_release); // 发布给消费者
+                _pushHits.fetch_add(1, std::memory_order_relaxed);
+                _objects.fetch_add(count, std::memory_order_relaxed);
+                return true;
+            }
+        } else if(diff < 0) { // 槽位中的批次还没被取走，缓冲区已满
+            _pushMisses.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else { // 其他生产者已经推进了位置，重新读取
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t TransferCache::pop(void*& start, void*& end) {
+    size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+    while(true) {
+        Slot& slot = _slots[pos % _capacity];
+        size_t seq = slot._seq.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if(diff == 0) { // 槽位中有可读的批次，尝试取走
+            if(_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                start = slot._start;
+                end = slot._end;
+                size_t count = slot._count;
+                slot._seq.store(pos + _capacity, std::memory_order_release); // 留给下一圈的生产者
+                _popHits.fetch_add(1, std::memory_order_relaxed);
+                _objects.fetch_sub(count, std::memory_order_relaxed);
+                return count;
+            }
+        } else if(diff < 0) { // 缓冲区为空
+            _popMisses.fetch_add(1, std::memory_order_relaxed);
+            return 0;
+        } else {
+            pos = _dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+} // namespace MyMemoryPool
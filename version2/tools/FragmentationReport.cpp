@@ -0,0 +1,149 @@
+// 按给定的大小分布统计各size class策略的内碎片（对齐后的大小减去请求的大小）
+// 用法: FragmentationReport [--dist=uniform:最小:最大 | --dist=lognormal:中位数:sigma | --file=路径] [--samples=N] [--top=N]
+//   --file的每行为"大小"或"大小 次数"，路径为-时从标准输入读取，可以直接使用分配日志的统计结果
+// 超过MAX_BYTES的请求走PageCache按整页分配，单独统计
+#include "../include/MemoryPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace MyMemoryPool;
+
+struct Request { // 一种请求大小及其出现次数
+    size_t _size;
+    uint64_t _count;
+};
+
+struct ClassUsage {
+    uint64_t _count = 0;
+    uint64_t _requested = 0;
+    uint64_t _allocated = 0;
+};
+
+template<typename Policy>
+static void report(const char* name, const std::vector<Request>& requests, size_t top) {
+    typedef SizeClassMap<Policy> Map;
+    std::vector<ClassUsage> usage(Map::NUM_CLASSES);
+    uint64_t requested = 0, allocated = 0, count = 0;
+    uint64_t largeRequested = 0, largeAllocated = 0, largeCount = 0;
+    size_t worstSize = 0, worstWaste = 0;
+    for(const Request& req : requests) {
+        if(req._size > MAX_BYTES) {
+            largeCount += req._count;
+            largeRequested += req._size * req._count;
+            largeAllocated += ((req._size + PAGE_SIZE - 1) & ~(size_t)(PAGE_SIZE - 1)) * req._count;
+            continue;
+        }
+        size_t index = Map::getIndex(req._size);
+        size_t waste = Map::classSize(index) - req._size;
+        if(waste > worstWaste) {
+            worstWaste = waste;
+            worstSize = req._size;
+        }
+        usage[index]._count += req._count;
+        usage[index]._requested += req._size * req._count;
+        usage[index]._allocated += Map::classSize(index) * req._count;
+        count += req._count;
+        requested += req._size * req._count;
+        allocated += Map::classSize(index) * req._count;
+    }
+    printf("== %s: %zu个size class ==\n", name, Map::NUM_CLASSES);
+    if(count > 0) {
+        printf("小对象: %llu次请求, 请求%llu字节, 实际%llu字节, 内碎片%.2f%%, 单个对象最多浪费%zu字节(请求%zu字节)\n",
+            (unsigned long long)count, (unsigned long long)requested, (unsigned long long)allocated,
+            100.0 * (allocated - requested) / allocated, worstWaste, worstSize);
+    }
+    if(largeCount > 0) {
+        printf("大对象: %llu次请求, 请求%llu字节, 实际%llu字节, 内碎片%.2f%%\n",
+            (unsigned long long)largeCount, (unsigned long long)largeRequested, (unsigned long long)largeAllocated,
+            100.0 * (largeAllocated - largeRequested) / largeAllocated);
+    }
+    std::vector<size_t> order; // 按浪费的字节数从大到小列出size class
+    for(size_t i = 0; i < Map::NUM_CLASSES; i++) {
+        if(usage[i]._count > 0) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return usage[a]._allocated - usage[a]._requested > usage[b]._allocated - usage[b]._requested;
+    });
+    if(order.size() > top) order.resize(top);
+    if(order.empty()) return;
+    printf("%6s %8s %12s %14s %10s\n", "index", "size", "count", "waste(B)", "waste(%)");
+    for(size_t i : order) {
+        const ClassUsage& cls = usage[i];
+        printf("%6zu %8zu %12llu %14llu %9.2f%%\n", i, Map::classSize(i), (unsigned long long)cls._count,
+            (unsigned long long)(cls._allocated - cls._requested), 100.0 * (cls._allocated - cls._requested) / cls._allocated);
+    }
+}
+
+static bool readFile(const char* path, std::vector<Request>& requests) {
+    FILE* fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if(fp == nullptr) return false;
+    char line[256];
+    while(fgets(line, sizeof(line), fp) != nullptr) {
+        unsigned long long size = 0, count = 1;
+        int fields = sscanf(line, "%llu %llu", &size, &count);
+        if(fields < 1 || size == 0) continue; // 空行或注释
+        requests.push_back({(size_t)size, fields == 2 ? (uint64_t)count : 1});
+    }
+    if(fp != stdin) fclose(fp);
+    return true;
+}
+
+static bool sampleDist(const char* dist, size_t samples, std::vector<Request>& requests) {
+    std::mt19937_64 rng(12345);
+    double a = 0, b = 0;
+    if(strncmp(dist, "uniform:", 8) == 0 && sscanf(dist + 8, "%lf:%lf", &a, &b) == 2 && a >= 1 && b >= a) {
+        std::uniform_int_distribution<size_t> uniform((size_t)a, (size_t)b);
+        for(size_t i = 0; i < samples; i++) requests.push_back({uniform(rng), 1});
+        return true;
+    }
+    if(strncmp(dist, "lognormal:", 10) == 0 && sscanf(dist + 10, "%lf:%lf", &a, &b) == 2 && a >= 1 && b > 0) {
+        std::lognormal_distribution<double> lognormal(std::log(a), b);
+        for(size_t i = 0; i < samples; i++) {
+            double size = lognormal(rng);
+            requests.push_back({size < 1 ? 1 : (size_t)size, 1});
+        }
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char** argv) {
+    std::string dist = "lognormal:64:1.5"; // 默认：中位数64字节、大部分落在几字节到几KB之间的典型分布
+    std::string file;
+    size_t samples = 1000000;
+    size_t top = 10;
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if(strncmp(arg, "--dist=", 7) == 0) dist = arg + 7;
+        else if(strncmp(arg, "--file=", 7) == 0) file = arg + 7;
+        else if(strncmp(arg, "--samples=", 10) == 0) samples = strtoull(arg + 10, nullptr, 10);
+        else if(strncmp(arg, "--top=", 6) == 0) top = strtoull(arg + 6, nullptr, 10);
+        else {
+            fprintf(stderr, "用法: %s [--dist=uniform:最小:最大|lognormal:中位数:sigma] [--file=路径|-] [--samples=N] [--top=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    std::vector<Request> requests;
+    if(!file.empty()) {
+        if(!readFile(file.c_str(), requests)) {
+            fprintf(stderr, "无法读取文件: %s\n", file.c_str());
+            return 1;
+        }
+        printf("分布: 文件%s中的%zu种大小\n", file.c_str(), requests.size());
+    }else {
+        if(!sampleDist(dist.c_str(), samples, requests)) {
+            fprintf(stderr, "无法解析分布: %s\n", dist.c_str());
+            return 1;
+        }
+        printf("分布: %s, %zu个样本\n", dist.c_str(), samples);
+    }
+    report<DefaultSizeClassPolicy>("DefaultSizeClassPolicy", requests, top);
+    report<FineSizeClassPolicy>("FineSizeClassPolicy", requests, top);
+    return 0;
+}